@@ -48,8 +48,8 @@ public:
 
     // Enqueue GPU Memory destruction
     // ^ A few design decisions to be made. This can be a lot of things:
-    // - some async task running in another thread(s). Here comes handy the
-    // thread safety of plf::hive ;-)
+    // - some async task running in another thread(s). Erasure from the hive
+    // then has to be synchronized, see ConcurrentHive.
     //   Pseudocode:
     //    thread/task_pool::fire_and_forget(() => { wait(texture);
     //    deviceDeleteTexture(texture); });
@@ -57,6 +57,8 @@ public:
     //   Pseudocode:
     //     queue.texturesToBeDestroyed.push_back({ .texture = mTexture; });
     // ...
+    // 03_intrusive_hive_singletonhub.cpp implements the latter with a
+    // lock-free DeferredDestructionQueue keyed by submission index.
   }
 
   ~Texture() {
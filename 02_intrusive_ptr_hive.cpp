@@ -15,7 +15,8 @@
 ///  1. make maps std::map<resource, state> memory safe!
 ///  2. implementation of intrusive_ptr_release super easy
 /// - compact storage
-/// - simultaneous thread-safe creation, access, erasure
+/// Note that plf::hive is not thread-safe on its own: simultaneous creation and
+/// erasure need synchronization, see ConcurrentHive in concurrent_hive.hpp.
 
 // https://www.w3.org/TR/webgpu/#dom-gpubuffer-internal-state-slot
 enum class TextureInternalState {
@@ -29,6 +30,18 @@ struct TextureToBeDestroyed {
   // vk::Texture texture;
 };
 
+class Texture;
+
+// Allocate Texture blocks on 64 KiB boundaries so that plf::hive can find the
+// block owning a Texture by masking its address. This makes
+// hive::erase_pointer in intrusive_ptr_release O(1) instead of walking the
+// hive's list of blocks.
+namespace plf {
+template <> struct hive_block_traits<Texture> {
+  static constexpr std::size_t block_alignment = 64 * 1024;
+};
+} // namespace plf
+
 // This is now our custom implementation. intrusive_ptr_release relies on
 // Resources singleton. It can be made into a template for easy writing just as
 // boost::intrusive_ptr
@@ -42,10 +55,15 @@ public:
   // "factory function" for creating textures and passing the hive to
   // constructor.
   static boost::intrusive_ptr<Texture> createTexture(plf::hive<Texture> *hive) {
-    auto it = hive->emplace(hive);
-    auto *p = &(*it);
+    Texture *texture = &*hive->emplace(hive);
 
-    return p;
+    // Taking the first reference here rather than through the intrusive_ptr
+    // constructor, which skips it for nullptr, tells the compiler emplace()
+    // never returns nullptr. Otherwise GCC reports the unconditional
+    // intrusive_ptr_add_ref in wgpuInstanceRequestTexture as writing to it.
+    intrusive_ptr_add_ref(texture);
+
+    return {texture, false};
   }
 
   // Follow: https://www.w3.org/TR/webgpu/#buffer-destruction
@@ -68,8 +86,8 @@ public:
 
     // Enqueue GPU Memory destruction
     // ^ A few design decisions to be made. This can be a lot of things:
-    // - some async task running in another thread(s). Here comes handy the
-    // thread safety of plf::hive ;-)
+    // - some async task running in another thread(s). Erasure from the hive
+    // then has to be synchronized, see ConcurrentHive.
     //   Pseudocode:
     //    thread/task_pool::fire_and_forget(() => { wait(texture);
     //    deviceDeleteTexture(texture); });
@@ -77,6 +95,8 @@ public:
     //   Pseudocode:
     //     queue.texturesToBeDestroyed.push_back({ .texture = mTexture; });
     // ...
+    // 03_intrusive_hive_singletonhub.cpp implements the latter with a
+    // lock-free DeferredDestructionQueue keyed by submission index.
   }
 
   ~Texture() {
@@ -101,16 +121,20 @@ protected:
   friend void intrusive_ptr_release(const Texture *p) noexcept;
 };
 
+// Relaxed increment, release decrement and an acquire fence only for the last
+// release, same as AtomicRefCount in ref_count_policy.hpp.
 inline void intrusive_ptr_add_ref(const Texture *p) noexcept {
-  p->mRefCounter++;
+  p->mRefCounter.fetch_add(1, std::memory_order_relaxed);
 }
 
 inline void intrusive_ptr_release(const Texture *p) noexcept {
-  if (--(p->mRefCounter) == 0) {
+  if (p->mRefCounter.fetch_sub(1, std::memory_order_release) == 1) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+
     // Hive(or any other structure) has to be stored inside the resources unless
     // no structures is used and resource is stored randomly in memory. Which
     // may be very unfortunate for cache misses in many situations.
-    p->mHive->erase(p->mHive->get_iterator(p));
+    p->mHive->erase_pointer(p);
   }
 }
 
@@ -1,153 +1,220 @@
-#include "plf_hive.hpp"
-#include "singleton_atomic.hpp"
-
-#include <boost/intrusive_ptr.hpp>
-
-#include <atomic>
-#include <cstdint>
+#include "hub_snapshot.hpp"
+#include "webgpu_resources.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
 #include <print>
+#include <string>
+
+/// This file expands the previous example by keeping all resources of a
+/// device in its own hub, Resources, instead of one hive per type. A
+/// resource does not have to store a pointer to the hub: intrusive_ptr_release
+/// finds it from the hive block the resource lives in, so every device, and
+/// the textures released to it, is independent of any other.
+///
+/// The resources, the per-device hub and the C API live in
+/// webgpu_resources.hpp so that the stress and benchmark targets can use them
+/// too, this is the walk through them.
 
-/// This file expands the previous example by creating Singleton for all
-/// resources so that a resoure does not have store pointer to the data
-/// structure but intrusive_ptr_release can reference it.
-
-// https://www.w3.org/TR/webgpu/#dom-gpubuffer-internal-state-slot
-enum class TextureInternalState {
-  Available,
-  Unavailable,
-  Destroyed,
-};
-
-// Have some class that can hold Vulkan object to be destroyed
-struct TextureToBeDestroyed {
-  // std::uint64_t submissionIndex;
-  // vk::Texture vulkanTexture;
-};
-
-// This is now our custom implementation. intrusive_ptr_release relies on
-// Resources singleton. It can be made into a template for easy writing just as
-// boost::intrusive_ptr
-class Texture {
-public:
-  Texture() noexcept { std::println("Texture::Constructor"); }
-
-#pragma region noncopyable
-  Texture(const Texture &) = delete;
-  Texture &operator=(const Texture &) = delete;
-  Texture(Texture &&) = delete;
-  Texture &operator=(Texture &&) = delete;
-#pragma ednregion noncopyable
-
-  // Follow: https://www.w3.org/TR/webgpu/#buffer-destruction
-  // Notice: no class destructor is called, this doesn't release CPU side
-  // object!
-  void destroy() {
-    if (mInternalState == TextureInternalState::Destroyed) {
-      // Valid according to the specification. Nothing to do.
-      return;
-    }
+int main() {
+  // Point WEBGPU_RESOURCE_PROFILE to a file to reserve the peak counts of the
+  // last run at device creation and record this run's ones at exit
+  const char *profilePath = std::getenv("WEBGPU_RESOURCE_PROFILE");
+
+  DeviceOptions options;
+  if (profilePath != nullptr && std::filesystem::exists(profilePath)) {
+    std::ifstream profileFile{profilePath};
+    options.profile = WorkloadProfile::load(profileFile);
+  }
 
-    // Unmap
-    // ...
-
-    // Set state to destroyed
-    mInternalState = TextureInternalState::Destroyed;
-
-    // If this was mappable buffer it could have had staging buffer that can be
-    // deleted immediately. if (stagingBuffer) delete staging;
-
-    // Enqueue GPU Memory destruction
-    // ^ A few design decisions to be made. This can be a lot of things:
-    // - some async task running in another thread(s). Here comes handy the
-    // thread safety of plf::hive ;-)
-    //   Pseudocode:
-    //    thread/task_pool::fire_and_forget(() => {
-    //      wait(lastSubmissionIndex);
-    //      deviceDeleteTexture(texture);
-    //    });
-    // - just a vector that is evaluated at each submit
-    //   Pseudocode:
-    //     queue.texturesToBeDestroyed.push_back({ .texture = mTexture; });
-    // ...
+  // Heap allocated, a device with all its hive shards is large
+  auto device = std::make_unique<Device>(options);
+  auto texture = device->createTexture();
+
+  CommandEncoder *commandEncoder = wgpuDeviceCreateCommandEncoder(device.get());
+  wgpuCommandEncoderAddRef(commandEncoder);
+  wgpuCommandEncoderRelease(commandEncoder);
+  wgpuCommandEncoderRelease(commandEncoder);
+
+  Sampler *sampler = wgpuDeviceCreateSampler(device.get());
+  wgpuSamplerRelease(sampler);
+
+  Buffer *buffer = wgpuDeviceCreateBuffer(device.get());
+  wgpuBufferRelease(buffer);
+
+  // The view keeps the texture alive after the caller released it
+  Texture *viewedTexture = wgpuInstanceRequestTexture(device.get());
+  TextureView *textureView = wgpuTextureCreateView(viewedTexture);
+  wgpuTextureRelease(viewedTexture);
+  wgpuTextureViewRelease(textureView);
+
+  Texture *streamedTextures[4];
+  wgpuDeviceCreateTextures(device.get(), std::size(streamedTextures),
+                           streamedTextures);
+  wgpuTextureReleaseMany(streamedTextures, std::size(streamedTextures));
+
+  TextureHandle textureHandle = wgpuDeviceCreateTextureHandle(device.get());
+  wgpuTextureHandleRelease(device.get(), textureHandle);
+  // Stale: the texture is gone and its slot may already be reused
+  wgpuTextureHandleRelease(device.get(), textureHandle);
+
+  // A second device shares no storage with the first one, and its textures
+  // are released to it without going through any global
+  {
+    Device otherDevice;
+    Texture *otherTexture = wgpuInstanceRequestTexture(&otherDevice);
+
+    // Device loss visits the textures on all cores
+    WorkStealingPool pool;
+    otherDevice.loseDevice(pool);
+    std::println("{0} destroyed textures on the lost device",
+                 otherDevice.countDestroyedTextures());
+    wgpuTextureRelease(otherTexture);
   }
 
-  virtual ~Texture() {
-    // Enqueue GPU memory destruction if explicit destroy() call was not made
-    if (mInternalState != TextureInternalState::Destroyed) {
-      destroy();
+  // Render targets recreated every frame come back from the recycle cache
+  // once the GPU is done with last frame's
+  {
+    DeviceOptions recyclingOptions;
+    recyclingOptions.textureRecycleBudget = 64 << 20;
+    Device recyclingDevice{recyclingOptions};
+    Queue &recyclingQueue = recyclingDevice.getQueue();
+
+    TextureDescriptor renderTarget;
+    renderTarget.width = 1920;
+    renderTarget.height = 1080;
+    renderTarget.format = TextureFormat::RGBA16Float;
+
+    for (int frame = 0; frame < 3; ++frame) {
+      Texture *target =
+          wgpuInstanceRequestTexture(&recyclingDevice, &renderTarget);
+      target->markUsed(recyclingQueue.getPendingSubmissionIndex());
+      wgpuTextureRelease(target);
+      wgpuQueueSubmit(&recyclingQueue);
+      // The last frame's submission finishes while this one is recorded
+      recyclingQueue.onSubmissionCompleted(
+          recyclingQueue.getLastSubmissionIndex());
     }
 
-    // Continue with destruction of actual CPU object of the implementation
-    std::println("Texture::Destructor with count {0}", mRefCounter.load());
+    const auto recycling = recyclingDevice.snapshotStats().textureRecycling;
+    std::println("render targets: {0} recycled, {1} created, {2} bytes cached",
+                 recycling.hits, recycling.misses, recycling.bytes);
   }
 
-protected:
-  TextureInternalState mInternalState{TextureInternalState::Available};
-  mutable std::atomic<std::uint64_t> mRefCounter{0};
-
-protected:
-  friend void intrusive_ptr_add_ref(const Texture *p) noexcept;
-  friend void intrusive_ptr_release(const Texture *p) noexcept;
-};
-
-#pragma region Singleton Resource Hub
-class Resources : public SingletonAtomic<Resources> {
-public:
-  Resources() {}
-
-  boost::intrusive_ptr<Texture> createTexture() {
-    boost::intrusive_ptr<Texture> texture{&(*mTextures.emplace())};
-
-    return texture;
+  // Block limits beyond what fits into a block are clamped to it instead of
+  // making the device constructor throw
+  {
+    DeviceOptions limitOptions;
+    limitOptions.blockLimits.emplace("texture", plf::hive_limits{8, 8192});
+    Device limitDevice{limitOptions};
+
+    Texture *limitTextures[1024];
+    wgpuDeviceCreateTextures(&limitDevice, std::size(limitTextures),
+                             limitTextures);
+    const ResourceTypeStats textureStats =
+        limitDevice.snapshotStats().types.front();
+    std::println("{0} textures in {1} blocks of at most {2}",
+                 textureStats.live, textureStats.blockCount,
+                 ResourceHive<Texture>::hive_type::block_capacity_hard_limits()
+                     .max);
+    wgpuTextureReleaseMany(limitTextures, std::size(limitTextures));
   }
 
-  // plf::hive has several nice properties for storage
-  // - stable pointers this is a trick that can help us
-  //  1. make maps std::map<resource, state> memory safe!
-  //  2. implementation of intrusive_ptr_release super easy
-  // - compact storage
-  // - simultaneous thread-safe creation, access, erasure
-  plf::hive<Texture> &getTextures() { return mTextures; }
-
-private:
-  plf::hive<Texture> mTextures;
-};
-#pragma endregion Singleton Resource Hub
-
-inline void intrusive_ptr_add_ref(const Texture *p) noexcept {
-  p->mRefCounter++;
-}
-
-inline void intrusive_ptr_release(const Texture *p) noexcept {
-  if (--(p->mRefCounter) == 0) {
-    auto &textures = Resources::GetInstance()->getTextures();
-    textures.erase(textures.get_iterator(p));
+  // Texture creation and freeing on worker threads, the calling thread only
+  // takes a hive slot
+  {
+    TaskPool taskPool{2};
+    DeviceOptions asyncOptions;
+    asyncOptions.taskPool = &taskPool;
+    Device asyncDevice{asyncOptions};
+
+    auto asyncTexture = asyncDevice.createTextureAsync(TextureDescriptor{});
+    taskPool.wait();
+    std::println("async texture available: {0}", asyncTexture->isAvailable());
+
+    asyncTexture->destroy();
+    wgpuQueueSubmit(&asyncDevice.getQueue());
+    // Resumes the worker waiting for submission 1, which frees the memory
+    asyncDevice.getQueue().onSubmissionCompleted(1);
+    taskPool.wait();
+    std::println("async device memory in use: {0} bytes",
+                 asyncDevice.snapshotStats().gpuMemory.usedBytes);
   }
-}
 
-// This part shows how raw native WebGPU functions can be now implemented using
-// above functionality.
-#pragma region WebGPU
-Texture *wgpuInstanceRequestTexture() {
-  boost::intrusive_ptr<Texture> texture{
-      Resources::GetInstance()->createTexture()};
+  Queue *queue = &device->getQueue();
+  Texture *destroyedTexture = wgpuInstanceRequestTexture(device.get());
+  // Recording a draw using the texture
+  destroyedTexture->markUsed(queue->getPendingSubmissionIndex());
+  wgpuQueueSubmit(queue);
+  wgpuTextureDestroy(destroyedTexture);
+  std::println("{0} destroyed textures still referenced",
+               device->countDestroyedTextures());
+  wgpuTextureRelease(destroyedTexture);
+
+  // Written straight into the device's persistently mapped staging ring
+  const std::uint32_t texel = 0xff00ffff;
+  wgpuQueueWriteTexture(queue, texture.get(), &texel, sizeof(texel));
+  // Buffer uploads share it
+  Buffer *uniformBuffer = wgpuDeviceCreateBuffer(device.get());
+  const float tint[4] = {1.0f, 0.5f, 0.25f, 1.0f};
+  wgpuQueueWriteBuffer(queue, uniformBuffer, 0, tint, sizeof(tint));
+  wgpuBufferRelease(uniformBuffer);
+
+  // The GPU may still be executing submission 1, nothing is freed yet
+  wgpuQueueSubmit(queue);
+  queue->onSubmissionCompleted(1);
+  wgpuQueueSubmit(queue);
+
+  // What a metrics exporter would push periodically
+  const ResourceStatsSnapshot stats = device->snapshotStats();
+  for (const ResourceTypeStats &typeStats : stats.types) {
+    if (typeStats.created != 0) {
+      std::println("{0}: {1} created, {2} released, {3} live in {4} blocks",
+                   typeStats.type, typeStats.created, typeStats.released,
+                   typeStats.live, typeStats.blockCount);
+    }
+  }
+  std::println("median texture destroy-to-release: <= {0} ns",
+               stats.textureDestroyToRelease.percentile(50).count());
+  std::println("staging memory in use: {0} of {1} bytes",
+               stats.staging.usedBytes, stats.staging.capacity);
+  std::println("texture memory: {0} bytes used of {1} in {2} driver "
+               "allocations",
+               stats.gpuMemory.usedBytes, stats.gpuMemory.reservedBytes,
+               stats.gpuMemory.driverMemoryCount);
+
+  // What a restarted process would bring the device back from: textures are
+  // recreated in parallel into hives reserved from the saved profile
+  {
+    const std::string snapshotPath =
+        (std::filesystem::temp_directory_path() / "webgpu_hub.snapshot")
+            .string();
+    {
+      std::ofstream snapshotFile{snapshotPath, std::ios::binary};
+      HubSnapshot::save(snapshotFile, *device, device->liveTextures());
+    }
 
-  // Because WebGPU functions do NOT return intrusive_ptr (that will be
-  // destroyed at the end of this function) but raw pointer we artificially
-  // increase reference. It will be 2 and 1 after end of this function
-  intrusive_ptr_add_ref(texture.get());
+    const HubSnapshot snapshot = HubSnapshot::open(snapshotPath.c_str());
+    DeviceOptions restoredOptions;
+    restoredOptions.profile = snapshot.profile();
+    Device restoredDevice{restoredOptions};
 
-  return texture.get();
-}
+    WorkStealingPool pool;
+    const auto restoredTextures =
+        restoredDevice.restoreTextures(snapshot.textures(), pool);
+    std::println("restored {0} textures from the snapshot",
+                 restoredTextures.size());
 
-void wgpuTextureDestroy(Texture *texture) { texture->destroy(); }
-void wgpuTextureAddRef(Texture *texture) { intrusive_ptr_add_ref(texture); }
-void wgpuTextureRelease(Texture *texture) { intrusive_ptr_release(texture); }
-#pragma endregion WebGPU
+    std::filesystem::remove(snapshotPath);
+  }
 
-int main() {
-  Resources::Construct();
-  auto texture = Resources::GetInstance()->createTexture();
+  if (profilePath != nullptr) {
+    std::ofstream profileFile{profilePath};
+    device->recordWorkloadProfile().save(profileFile);
+  }
 
   std::println("the end");
-}
\ No newline at end of file
+}
@@ -0,0 +1,112 @@
+#include "ref_count_policy.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <print>
+#include <thread>
+#include <vector>
+
+/// Measures the cost of one AddRef + Release pair with the default seq_cst
+/// ordering (what intrusive_ptr_add_ref/release used to do) against the
+/// relaxed increment / release decrement of AtomicRefCount.
+///
+/// On x86 every atomic read-modify-write is a locked instruction whatever the
+/// ordering, so both should be close there. On ARM seq_cst RMWs need
+/// acquire+release semantics (ldaddal, or ldxr/stxr with dmb) which is where
+/// the difference shows.
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+constexpr const char *kArchitecture = "arm64";
+#elif defined(__x86_64__) || defined(_M_X64)
+constexpr const char *kArchitecture = "x86-64";
+#else
+constexpr const char *kArchitecture = "unknown";
+#endif
+
+// What intrusive_ptr_add_ref/intrusive_ptr_release did before
+struct SeqCstRefCount {
+  using counter_type = std::atomic<std::uint64_t>;
+
+  static void increment(counter_type &counter) noexcept { counter++; }
+
+  static bool decrement(counter_type &counter) noexcept {
+    return --counter == 0;
+  }
+};
+
+struct alignas(64) PaddedCounter {
+  std::atomic<std::uint64_t> value{1};
+};
+
+constexpr std::size_t kIterations = 20'000'000;
+
+// Every thread does kIterations AddRef + Release pairs, either on its own
+// counter (uncontended, the usual case) or all of them on the same one (a
+// shared resource like a default sampler). The counters start at 1 so they
+// never reach zero. Returns nanoseconds per pair.
+template <typename Policy>
+double measure(std::size_t threadCount, bool shared) {
+  std::vector<PaddedCounter> counters(shared ? 1 : threadCount);
+  std::atomic<std::size_t> ready{0};
+  std::atomic<bool> start{false};
+  std::vector<std::thread> threads;
+
+  for (std::size_t t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&, t] {
+      auto &counter = counters[shared ? 0 : t].value;
+
+      ready.fetch_add(1);
+      while (!start.load(std::memory_order_acquire)) {
+      }
+
+      for (std::size_t i = 0; i < kIterations; ++i) {
+        Policy::increment(counter);
+        Policy::decrement(counter);
+      }
+    });
+  }
+
+  while (ready.load() != threadCount) {
+  }
+
+  const auto begin = std::chrono::steady_clock::now();
+  start.store(true, std::memory_order_release);
+
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  const auto end = std::chrono::steady_clock::now();
+  const double ns =
+      std::chrono::duration<double, std::nano>(end - begin).count();
+
+  return ns / kIterations;
+}
+
+template <typename Policy>
+void report(const char *name, std::size_t threadCount, bool shared) {
+  std::println("{0:<10} threads={1:<3} {2:<11} {3:8.2f} ns/pair", name,
+               threadCount, shared ? "shared" : "uncontended",
+               measure<Policy>(threadCount, shared));
+}
+
+int main() {
+  const std::size_t hardwareThreads =
+      std::max(1u, std::thread::hardware_concurrency());
+
+  std::println("architecture: {0}, hardware threads: {1}", kArchitecture,
+               hardwareThreads);
+
+  report<SeqCstRefCount>("seq_cst", 1, false);
+  report<AtomicRefCount>("relaxed", 1, false);
+
+  if (hardwareThreads > 1) {
+    for (bool shared : {false, true}) {
+      report<SeqCstRefCount>("seq_cst", hardwareThreads, shared);
+      report<AtomicRefCount>("relaxed", hardwareThreads, shared);
+    }
+  }
+}
@@ -0,0 +1,413 @@
+#include "concurrent_hive.hpp"
+#include "intrusive_resource.hpp"
+#include "plf_hive.hpp"
+
+#include <boost/smart_ptr/intrusive_ref_counter.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <print>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/// Compares the three ways the examples store and reference count textures:
+/// - heap: boost::intrusive_ref_counter, new/delete (01_intrusive_ptr)
+/// - backptr: plf::hive, every texture points back to its hive
+///   (02_intrusive_ptr_hive). With more than one thread the hive is guarded
+///   by a single mutex, which is what that design needs to be thread-safe.
+/// - hub: IntrusiveResource in a ConcurrentHive found through the block
+///   header, no back-pointer (03_intrusive_hive_singletonhub)
+///
+/// Every thread keeps liveCount / threadCount textures alive and churns
+/// through random ones of them: destroy (release the last reference), create
+/// a replacement, then AddRef and Release (not the last reference) some. Ops
+/// are timed in batches of kBatchSize, p50/p99 are over the per-op average of
+/// each batch. Where perf counters are accessible (Linux with a permissive
+/// perf_event_paranoid) last-level cache misses per op are reported too.
+
+constexpr std::size_t kBatchSize = 32;
+constexpr std::size_t kBatchesPerThread = 2000;
+
+// Same payload for every strategy, about what a texture descriptor holds
+struct TexturePayload {
+  std::array<std::uint64_t, 6> fields{};
+};
+
+#pragma region Strategies
+class HeapTexture : public boost::intrusive_ref_counter<HeapTexture> {
+public:
+  TexturePayload payload;
+};
+
+struct HeapStrategy {
+  static constexpr const char *kName = "heap";
+  using Object = HeapTexture;
+
+  struct Storage {};
+
+  static Object *create(Storage &) {
+    Object *texture = new HeapTexture;
+    intrusive_ptr_add_ref(texture);
+
+    return texture;
+  }
+};
+
+class BackPointerTexture;
+class HubTexture;
+
+namespace plf {
+template <> struct hive_block_traits<BackPointerTexture> {
+  static constexpr std::size_t block_alignment = 64 * 1024;
+};
+
+template <> struct hive_block_traits<HubTexture> {
+  static constexpr std::size_t block_alignment = 64 * 1024;
+};
+} // namespace plf
+
+struct LockedHive;
+
+class BackPointerTexture {
+public:
+  explicit BackPointerTexture(LockedHive *hive) noexcept : mHive{hive} {}
+
+  TexturePayload payload;
+
+private:
+  std::atomic<std::uint64_t> mRefCounter{0};
+  LockedHive *mHive;
+
+  friend void intrusive_ptr_add_ref(BackPointerTexture *p) noexcept {
+    p->mRefCounter.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  friend void intrusive_ptr_release(BackPointerTexture *p);
+};
+
+struct LockedHive {
+  std::mutex mutex;
+  plf::hive<BackPointerTexture> hive;
+};
+
+inline void intrusive_ptr_release(BackPointerTexture *p) {
+  if (p->mRefCounter.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    LockedHive *hive = p->mHive;
+    std::lock_guard lock{hive->mutex};
+    hive->hive.erase_pointer(p);
+  }
+}
+
+struct BackPointerStrategy {
+  static constexpr const char *kName = "backptr";
+  using Object = BackPointerTexture;
+
+  using Storage = LockedHive;
+
+  static Object *create(Storage &storage) {
+    Object *texture;
+    {
+      std::lock_guard lock{storage.mutex};
+      texture = &(*storage.hive.emplace(&storage));
+    }
+    intrusive_ptr_add_ref(texture);
+
+    return texture;
+  }
+};
+
+struct BenchHub {
+  template <typename T> static void erase(const T *resource) {
+    ConcurrentHive<T>::erase(resource);
+  }
+};
+
+class HubTexture final : public IntrusiveResource<HubTexture, BenchHub> {
+public:
+  TexturePayload payload;
+};
+
+struct HubStrategy {
+  static constexpr const char *kName = "hub";
+  using Object = HubTexture;
+
+  using Storage = ConcurrentHive<HubTexture>;
+
+  static Object *create(Storage &storage) {
+    Object *texture = storage.emplace();
+    intrusive_ptr_add_ref(texture);
+
+    return texture;
+  }
+};
+#pragma endregion Strategies
+
+#pragma region Measurement
+// Last-level cache misses of the calling thread, if the kernel lets us
+class CacheMissCounter {
+public:
+  CacheMissCounter() {
+#if defined(__linux__)
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    mFd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+  }
+
+#pragma region noncopyable
+  CacheMissCounter(const CacheMissCounter &) = delete;
+  CacheMissCounter &operator=(const CacheMissCounter &) = delete;
+  CacheMissCounter(CacheMissCounter &&) = delete;
+  CacheMissCounter &operator=(CacheMissCounter &&) = delete;
+#pragma endregion noncopyable
+
+  ~CacheMissCounter() {
+#if defined(__linux__)
+    if (mFd >= 0) {
+      close(mFd);
+    }
+#endif
+  }
+
+  bool available() const noexcept { return mFd >= 0; }
+
+  void start() noexcept {
+#if defined(__linux__)
+    if (available()) {
+      ioctl(mFd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(mFd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  std::uint64_t stop() noexcept {
+    std::uint64_t misses = 0;
+#if defined(__linux__)
+    if (available()) {
+      ioctl(mFd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(mFd, &misses, sizeof(misses)) != sizeof(misses)) {
+        misses = 0;
+      }
+    }
+#endif
+    return misses;
+  }
+
+private:
+  int mFd = -1;
+};
+
+enum Operation : std::size_t { Create, Destroy, AddRef, Release, kOperations };
+
+constexpr std::array<const char *, kOperations> kOperationNames{
+    "create", "destroy", "addref", "release"};
+
+struct ThreadResult {
+  // Nanoseconds per op of every batch
+  std::array<std::vector<double>, kOperations> samples;
+  std::array<double, kOperations> totalNs{};
+  std::array<std::size_t, kOperations> totalOps{};
+  std::uint64_t cacheMisses = 0;
+  bool cacheMissesAvailable = false;
+};
+
+template <typename Strategy>
+ThreadResult runThread(typename Strategy::Storage &storage,
+                       std::size_t liveCount, unsigned seed,
+                       std::atomic<std::size_t> &ready,
+                       std::atomic<bool> &start) {
+  using Object = typename Strategy::Object;
+  using Clock = std::chrono::steady_clock;
+
+  std::vector<Object *> live(liveCount);
+  for (Object *&object : live) {
+    object = Strategy::create(storage);
+  }
+
+  // Pick the indices up front so that the timed loops only do the ops
+  std::mt19937 random{seed};
+  std::uniform_int_distribution<std::size_t> pick{0, liveCount - 1};
+  std::vector<std::size_t> indices(kBatchesPerThread * kBatchSize);
+  for (std::size_t &index : indices) {
+    index = pick(random);
+  }
+
+  ThreadResult result;
+  for (auto &samples : result.samples) {
+    samples.reserve(kBatchesPerThread);
+  }
+
+  CacheMissCounter cacheMisses;
+  result.cacheMissesAvailable = cacheMisses.available();
+
+  // Populated, so that every thread times under the same concurrency
+  ready.fetch_add(1);
+  while (!start.load(std::memory_order_acquire)) {
+  }
+
+  cacheMisses.start();
+
+  for (std::size_t batch = 0; batch < kBatchesPerThread; ++batch) {
+    // Indices may repeat within a batch, skip duplicates when destroying
+    std::array<std::size_t, kBatchSize> slots;
+    std::copy_n(indices.begin() + batch * kBatchSize, kBatchSize,
+                slots.begin());
+    std::sort(slots.begin(), slots.end());
+    const std::size_t unique = static_cast<std::size_t>(
+        std::unique(slots.begin(), slots.end()) - slots.begin());
+
+    const auto timed = [&](Operation operation, std::size_t ops, auto &&op) {
+      const auto begin = Clock::now();
+      op();
+      const double ns =
+          std::chrono::duration<double, std::nano>(Clock::now() - begin)
+              .count();
+      result.samples[operation].push_back(ns / static_cast<double>(ops));
+      result.totalNs[operation] += ns;
+      result.totalOps[operation] += ops;
+    };
+
+    timed(Destroy, unique, [&] {
+      for (std::size_t i = 0; i < unique; ++i) {
+        intrusive_ptr_release(live[slots[i]]);
+      }
+    });
+    timed(Create, unique, [&] {
+      for (std::size_t i = 0; i < unique; ++i) {
+        live[slots[i]] = Strategy::create(storage);
+      }
+    });
+    timed(AddRef, kBatchSize, [&] {
+      for (std::size_t i = 0; i < kBatchSize; ++i) {
+        intrusive_ptr_add_ref(live[indices[batch * kBatchSize + i]]);
+      }
+    });
+    timed(Release, kBatchSize, [&] {
+      for (std::size_t i = 0; i < kBatchSize; ++i) {
+        intrusive_ptr_release(live[indices[batch * kBatchSize + i]]);
+      }
+    });
+  }
+
+  result.cacheMisses = cacheMisses.stop();
+
+  for (Object *object : live) {
+    intrusive_ptr_release(object);
+  }
+
+  return result;
+}
+
+double percentile(std::vector<double> &samples, double fraction) {
+  const auto nth = samples.begin() + static_cast<std::ptrdiff_t>(
+                                         fraction * (samples.size() - 1));
+  std::nth_element(samples.begin(), nth, samples.end());
+
+  return *nth;
+}
+
+template <typename Strategy>
+void report(std::size_t liveCount, std::size_t threadCount) {
+  typename Strategy::Storage storage;
+  std::atomic<std::size_t> ready{0};
+  std::atomic<bool> start{false};
+  std::vector<ThreadResult> results(threadCount);
+  std::vector<std::thread> threads;
+
+  for (std::size_t t = 0; t < threadCount; ++t) {
+    threads.emplace_back([&, t] {
+      results[t] =
+          runThread<Strategy>(storage, liveCount / threadCount,
+                              static_cast<unsigned>(t + 1), ready, start);
+    });
+  }
+
+  while (ready.load() != threadCount) {
+  }
+
+  start.store(true, std::memory_order_release);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::uint64_t cacheMisses = 0;
+  std::size_t totalOps = 0;
+  bool cacheMissesAvailable = true;
+  for (const ThreadResult &result : results) {
+    cacheMisses += result.cacheMisses;
+    cacheMissesAvailable &= result.cacheMissesAvailable;
+    for (std::size_t ops : result.totalOps) {
+      totalOps += ops;
+    }
+  }
+
+  for (std::size_t operation = 0; operation < kOperations; ++operation) {
+    std::vector<double> samples;
+    double totalNs = 0;
+    std::size_t ops = 0;
+    for (ThreadResult &result : results) {
+      samples.insert(samples.end(), result.samples[operation].begin(),
+                     result.samples[operation].end());
+      totalNs += result.totalNs[operation];
+      ops += result.totalOps[operation];
+    }
+
+    // Threads run concurrently, so the aggregate rate is the average
+    // per-thread rate times the thread count
+    const double mops = static_cast<double>(ops) * 1e3 / totalNs *
+                        static_cast<double>(threadCount);
+
+    std::println("{0:<8} live={1:<8} threads={2:<3} {3:<8} p50={4:7.1f} ns "
+                 "p99={5:7.1f} ns {6:8.2f} Mops/s",
+                 Strategy::kName, liveCount, threadCount,
+                 kOperationNames[operation], percentile(samples, 0.5),
+                 percentile(samples, 0.99), mops);
+  }
+
+  if (cacheMissesAvailable) {
+    std::println("{0:<8} live={1:<8} threads={2:<3} {3:.2f} cache misses/op",
+                 Strategy::kName, liveCount, threadCount,
+                 static_cast<double>(cacheMisses) /
+                     static_cast<double>(totalOps));
+  }
+}
+#pragma endregion Measurement
+
+int main() {
+  const std::size_t hardwareThreads =
+      std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<std::size_t> threadCounts{1};
+  if (hardwareThreads >= 4) {
+    threadCounts.push_back(4);
+  }
+  if (hardwareThreads > 4) {
+    threadCounts.push_back(hardwareThreads);
+  }
+
+  for (std::size_t liveCount : {1'000, 100'000, 1'000'000}) {
+    for (std::size_t threadCount : threadCounts) {
+      report<HeapStrategy>(liveCount, threadCount);
+      report<BackPointerStrategy>(liveCount, threadCount);
+      report<HubStrategy>(liveCount, threadCount);
+    }
+  }
+}
@@ -0,0 +1,225 @@
+#ifndef BIASED_REF_COUNT_HPP_
+#define BIASED_REF_COUNT_HPP_
+
+#include "ref_count_policy.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+/// Biased reference counting (Choi, Shull, Torrellas: "Biased Reference
+/// Counting", PACT 2018) for resources every thread keeps referencing, like
+/// texture atlases and default samplers, where a single atomic counter makes
+/// its cache line bounce between all cores.
+///
+/// The thread taking the first reference becomes the owner. It counts its own
+/// references in a plain integer, all other threads use a shared atomic one.
+/// Once the owner drops its last reference it merges: from then on only the
+/// shared counter is used and whoever brings it to zero releases the object.
+///
+/// A reference taken by the owner may be released by another thread, making
+/// the shared count negative. That thread then queues the object for its
+/// owner, which merges it on its next BiasedRefCount::mergeQueued() call. Owner
+/// threads therefore have to call mergeQueued() regularly, e.g. once per
+/// submit; objects waiting in the queue are released at that point. When an
+/// owner thread exits it merges its queue one last time and any later request
+/// is merged directly by the releasing thread. A counter is queued at most
+/// once at a time, so it is linked into the queue itself and releasing never
+/// allocates.
+struct BiasedRefCount {
+  struct OwnerThread;
+
+  struct counter_type {
+    // Set once by the first increment and never changed afterwards. Only
+    // dereferenced until the object is merged.
+    std::atomic<OwnerThread *> owner{nullptr};
+    // Only written by the owner thread (or by whoever merges after it
+    // exited), with plain loads and stores. Atomic so that load() may read it
+    // from any thread.
+    std::atomic<std::uint64_t> biased{0};
+    // References held by other threads times kOne, plus kMerged/kQueued flags
+    std::atomic<std::int64_t> shared{0};
+    // Next counter in the owner's queue and how to release this one once
+    // merged, only used while kQueued is set
+    counter_type *queuedNext = nullptr;
+    DeferredRelease queuedRelease{};
+  };
+
+  static void increment(counter_type &counter) noexcept {
+    OwnerThread *self = currentThread();
+    OwnerThread *owner = counter.owner.load(std::memory_order_relaxed);
+
+    const std::uint64_t biased = counter.biased.load(std::memory_order_relaxed);
+
+    if (owner == self && biased != 0) {
+      counter.biased.store(biased + 1, std::memory_order_relaxed);
+    } else if (owner == nullptr) {
+      // First reference, nobody else can see the object yet
+      self->mUnmerged.fetch_add(1, std::memory_order_relaxed);
+      counter.owner.store(self, std::memory_order_relaxed);
+      counter.biased.store(1, std::memory_order_relaxed);
+    } else {
+      counter.shared.fetch_add(kOne, std::memory_order_relaxed);
+    }
+  }
+
+  static bool decrement(counter_type &counter, DeferredRelease release) {
+    OwnerThread *owner = counter.owner.load(std::memory_order_relaxed);
+
+    // The biased count is the owner's own, other threads never change it
+    const std::uint64_t biased =
+        (owner == currentThread())
+            ? counter.biased.load(std::memory_order_relaxed)
+            : 0;
+
+    if (biased != 0) {
+      counter.biased.store(biased - 1, std::memory_order_relaxed);
+      if (biased != 1) {
+        return false;
+      }
+
+      // Hand over to the shared counter. A queued request is still pending
+      // and will finish the release when the owner processes it.
+      const std::int64_t old =
+          counter.shared.fetch_or(kMerged, std::memory_order_acq_rel);
+      owner->releaseUnmerged();
+      return count(old) == 0 && (old & kQueued) == 0;
+    }
+
+    std::int64_t value =
+        counter.shared.fetch_sub(kOne, std::memory_order_release) - kOne;
+
+    if (value & kMerged) {
+      if (value == kMerged) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return true;
+      }
+
+      return false;
+    }
+
+    // Released more references than this and other non-owner threads took:
+    // the rest is counted by the owner, which has to merge to find out when
+    // everything is gone.
+    while (count(value) < 0 && (value & (kMerged | kQueued)) == 0) {
+      if (counter.shared.compare_exchange_weak(value, value | kQueued,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_relaxed)) {
+        owner->enqueue(counter, release);
+        break;
+      }
+    }
+
+    return false;
+  }
+
+  // Only a snapshot while threads other than the caller change the counts
+  static std::uint64_t load(const counter_type &counter) noexcept {
+    return counter.biased.load(std::memory_order_relaxed) +
+           count(counter.shared.load(std::memory_order_relaxed));
+  }
+
+  // Merge every object other threads queued for the calling thread, releasing
+  // those whose last reference is gone.
+  static void mergeQueued() {
+    OwnerThread *self = currentThread();
+    self->mergeRequests(
+        self->mQueue.exchange(nullptr, std::memory_order_acquire));
+  }
+
+  struct OwnerThread {
+    // Only called by the thread that set kQueued
+    void enqueue(counter_type &counter, DeferredRelease release) {
+      counter.queuedRelease = release;
+      counter.queuedNext = mQueue.load(std::memory_order_acquire);
+
+      while (counter.queuedNext != closed()) {
+        if (mQueue.compare_exchange_weak(counter.queuedNext, &counter,
+                                         std::memory_order_release,
+                                         std::memory_order_acquire)) {
+          return;
+        }
+      }
+
+      // The owner has exited, nobody touches the biased count anymore
+      counter.queuedNext = nullptr;
+      mergeRequests(&counter);
+    }
+
+    void mergeRequests(counter_type *counter) {
+      while (counter != nullptr) {
+        // Merging may release the object and the counter with it
+        counter_type *next = counter->queuedNext;
+        merge(*counter);
+        counter = next;
+      }
+    }
+
+    void merge(counter_type &counter) {
+      const DeferredRelease release = counter.queuedRelease;
+      const std::uint64_t biased =
+          counter.biased.load(std::memory_order_relaxed);
+      counter.biased.store(0, std::memory_order_relaxed);
+
+      // An owner that already dropped its last reference set kMerged itself
+      const std::int64_t delta =
+          (biased != 0)
+              ? static_cast<std::int64_t>(biased) * kOne + kMerged - kQueued
+              : -kQueued;
+      const std::int64_t value =
+          counter.shared.fetch_add(delta, std::memory_order_acq_rel) + delta;
+
+      if (biased != 0) {
+        releaseUnmerged();
+      }
+
+      if (value == kMerged) {
+        release();
+      }
+    }
+
+    // The OwnerThread is kept alive by its running thread and by every object
+    // still pointing to it that hasn't merged yet.
+    void releaseUnmerged() {
+      if (mUnmerged.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete this;
+      }
+    }
+
+    static counter_type *closed() noexcept {
+      static counter_type sentinel{};
+      return &sentinel;
+    }
+
+    std::atomic<counter_type *> mQueue{nullptr};
+    std::atomic<std::uint64_t> mUnmerged{1};
+  };
+
+private:
+  static constexpr std::int64_t kMerged = 1;
+  static constexpr std::int64_t kQueued = 2;
+  static constexpr int kFlagBits = 2;
+  static constexpr std::int64_t kOne = std::int64_t{1} << kFlagBits;
+
+  static std::int64_t count(std::int64_t shared) noexcept {
+    return shared >> kFlagBits;
+  }
+
+  // Closes the queue and merges what's left when the thread exits. Objects
+  // that are still unmerged keep the OwnerThread alive after that.
+  struct ThreadExit {
+    OwnerThread *thread = new OwnerThread;
+
+    ~ThreadExit() {
+      thread->mergeRequests(thread->mQueue.exchange(
+          OwnerThread::closed(), std::memory_order_acq_rel));
+      thread->releaseUnmerged();
+    }
+  };
+
+  static OwnerThread *currentThread() noexcept {
+    thread_local ThreadExit exit;
+    return exit.thread;
+  }
+};
+
+#endif // BIASED_REF_COUNT_HPP_
@@ -0,0 +1,222 @@
+#ifndef BLOCK_POOL_HPP_
+#define BLOCK_POOL_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+/// Slab allocator for the aligned blocks of resource hives. With
+/// plf::hive_block_traits every hive block of a resource type is exactly
+/// block_alignment bytes on a block_alignment boundary, so blocks of all
+/// resource types of a device can share one pool of equal-sized slots:
+/// allocating and freeing a block (new hive groups, trim_capacity) is an O(1)
+/// free-list operation instead of a trip to the general heap.
+///
+/// Blocks are carved from chunks of kChunkSize bytes, which are
+/// - backed by transparent huge pages on Linux, to cut TLB misses and faults
+/// - written to once when allocated, so no page faults happen later when a
+///   hive fills a block. reserve() does that up front, e.g. at device creation.
+/// Chunks are returned to the system by releaseFreeChunks() once none of their
+/// blocks is in use, or when the pool is destroyed.
+///
+/// Thread-safe. Blocks are allocated rarely enough that a mutex is fine.
+class BlockPool {
+public:
+  static constexpr std::size_t kChunkSize = 2 * 1024 * 1024;
+
+  explicit BlockPool(std::size_t blockSize) : mBlockSize{blockSize} {
+    assert(blockSize != 0 && (blockSize & (blockSize - 1)) == 0);
+    assert(blockSize <= kChunkSize);
+  }
+
+#pragma region noncopyable
+  BlockPool(const BlockPool &) = delete;
+  BlockPool &operator=(const BlockPool &) = delete;
+  BlockPool(BlockPool &&) = delete;
+  BlockPool &operator=(BlockPool &&) = delete;
+#pragma endregion noncopyable
+
+  ~BlockPool() {
+    for (void *chunk : mChunks) {
+      ::operator delete(chunk, std::align_val_t{kChunkSize});
+    }
+  }
+
+  std::size_t blockSize() const noexcept { return mBlockSize; }
+
+  void *allocate() {
+    std::lock_guard lock{mMutex};
+
+    if (mFreeBlocks == nullptr) {
+      addChunk();
+    }
+
+    FreeBlock *block = mFreeBlocks;
+    mFreeBlocks = block->next;
+
+    return block;
+  }
+
+  void deallocate(void *block) noexcept {
+    std::lock_guard lock{mMutex};
+
+    mFreeBlocks = ::new (block) FreeBlock{mFreeBlocks};
+  }
+
+  // Make sure at least blockCount blocks can be allocated without going to
+  // the system.
+  void reserve(std::size_t blockCount) {
+    std::lock_guard lock{mMutex};
+
+    std::size_t available = 0;
+    for (const FreeBlock *block = mFreeBlocks;
+         block != nullptr && available < blockCount; block = block->next) {
+      ++available;
+    }
+
+    for (; available < blockCount; available += kChunkSize / mBlockSize) {
+      addChunk();
+    }
+  }
+
+  // Return every chunk none of whose blocks is allocated to the system, e.g.
+  // after hives freed their empty blocks following a scene unload. Walks the
+  // whole free list, so call it when idle, see TrimScheduler. Returns the
+  // number of chunks released.
+  std::size_t releaseFreeChunks() {
+    std::lock_guard lock{mMutex};
+
+    const std::size_t blocksPerChunk = kChunkSize / mBlockSize;
+    std::sort(mChunks.begin(), mChunks.end(), std::less<void *>{});
+
+    // Chunks are kChunkSize aligned, so a block's chunk is found by masking
+    const auto chunkIndex = [this](const FreeBlock *block) {
+      void *chunk = reinterpret_cast<void *>(
+          reinterpret_cast<std::uintptr_t>(block) & ~(kChunkSize - 1));
+      return static_cast<std::size_t>(
+          std::lower_bound(mChunks.begin(), mChunks.end(), chunk,
+                           std::less<void *>{}) -
+          mChunks.begin());
+    };
+
+    std::vector<std::size_t> freeBlockCounts(mChunks.size(), 0);
+    for (const FreeBlock *block = mFreeBlocks; block != nullptr;
+         block = block->next) {
+      ++freeBlockCounts[chunkIndex(block)];
+    }
+
+    // Unlink the blocks of the chunks about to be released
+    FreeBlock **link = &mFreeBlocks;
+    while (*link != nullptr) {
+      if (freeBlockCounts[chunkIndex(*link)] == blocksPerChunk) {
+        *link = (*link)->next;
+      } else {
+        link = &(*link)->next;
+      }
+    }
+
+    std::size_t released = 0;
+    for (std::size_t i = 0; i < mChunks.size(); ++i) {
+      if (freeBlockCounts[i] == blocksPerChunk) {
+        ::operator delete(mChunks[i], std::align_val_t{kChunkSize});
+        mChunks[i] = nullptr;
+        ++released;
+      }
+    }
+    std::erase(mChunks, nullptr);
+
+    return released;
+  }
+
+private:
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  void addChunk() {
+    mChunks.reserve(mChunks.size() + 1);
+    char *chunk = static_cast<char *>(
+        ::operator new(kChunkSize, std::align_val_t{kChunkSize}));
+    mChunks.push_back(chunk);
+
+#if defined(__linux__)
+    madvise(chunk, kChunkSize, MADV_HUGEPAGE);
+#endif
+    // Fault every page in now rather than when a hive starts using a block
+    std::memset(chunk, 0, kChunkSize);
+
+    // Hand out lower addresses first
+    for (std::size_t offset = kChunkSize; offset != 0;) {
+      offset -= mBlockSize;
+      mFreeBlocks = ::new (chunk + offset) FreeBlock{mFreeBlocks};
+    }
+  }
+
+  const std::size_t mBlockSize;
+
+  std::mutex mMutex;
+  FreeBlock *mFreeBlocks = nullptr;
+  std::vector<void *> mChunks;
+};
+
+/// Allocator for plf::hive taking its aligned blocks from a BlockPool and
+/// everything else (the small group structs) from the heap. A
+/// default-constructed one doesn't use a pool at all.
+template <typename T> class BlockPoolAllocator {
+public:
+  using value_type = T;
+
+  BlockPoolAllocator() noexcept = default;
+  explicit BlockPoolAllocator(BlockPool &pool) noexcept : mPool{&pool} {}
+
+  template <typename U>
+  BlockPoolAllocator(const BlockPoolAllocator<U> &other) noexcept
+      : mPool{other.pool()} {}
+
+  T *allocate(std::size_t n) {
+    if (isPoolBlock(n)) {
+      return static_cast<T *>(mPool->allocate());
+    }
+
+    return std::allocator<T>{}.allocate(n);
+  }
+
+  void deallocate(T *p, std::size_t n) noexcept {
+    if (isPoolBlock(n)) {
+      mPool->deallocate(p);
+      return;
+    }
+
+    std::allocator<T>{}.deallocate(p, n);
+  }
+
+  BlockPool *pool() const noexcept { return mPool; }
+
+  friend bool operator==(const BlockPoolAllocator &a,
+                         const BlockPoolAllocator &b) noexcept {
+    return a.mPool == b.mPool;
+  }
+
+private:
+  // plf::hive allocates each aligned block as a single object whose size and
+  // alignment are the block size
+  bool isPoolBlock(std::size_t n) const noexcept {
+    return mPool != nullptr && n == 1 && sizeof(T) == mPool->blockSize() &&
+           alignof(T) == mPool->blockSize();
+  }
+
+  BlockPool *mPool = nullptr;
+};
+
+#endif // BLOCK_POOL_HPP_
@@ -0,0 +1,428 @@
+#ifndef CONCURRENT_HIVE_HPP_
+#define CONCURRENT_HIVE_HPP_
+
+#include "plf_hive.hpp"
+#include "work_stealing_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+// Define to 1 to count shard lock acquisitions, contention and hold time, see
+// ConcurrentHive::lockStats. Off by default, it reads the clock twice per lock.
+#ifndef CONCURRENT_HIVE_LOCK_STATS
+#define CONCURRENT_HIVE_LOCK_STATS 0
+#endif
+
+namespace concurrent_hive_detail {
+// Threads get consecutive indices on first use, shared by every
+// ConcurrentHive, so that N threads spread over N shards.
+inline std::size_t threadIndex() noexcept {
+  static std::atomic<std::size_t> nextIndex{0};
+  thread_local const std::size_t index =
+      nextIndex.fetch_add(1, std::memory_order_relaxed);
+
+  return index;
+}
+} // namespace concurrent_hive_detail
+
+/// plf::hive on its own is NOT thread-safe: emplace and erase both modify the
+/// block lists, skipfields and free lists shared by all elements. This wraps
+/// it into a set of shards, each a plf::hive guarded by its own mutex.
+///
+/// - a thread always creates in the shard it was assigned on first use, so
+///   with at least as many shards as threads creation never contends
+/// - erase returns an element to the shard owning its block, whichever thread
+///   does the final release, found in O(1) through plf::hive::get_owner()
+///
+/// Because of the latter T has to opt into aligned blocks through
+/// plf::hive_block_traits. Each shard is the plf::hive an element's block
+/// header points to, so erase() and contextOf() only need the element: any
+/// number of ConcurrentHives can coexist (e.g. one per device) without their
+/// elements storing a back-pointer.
+///
+/// Elements are inserted with plf::hive::emplace_dense, so that groups left
+/// sparse by mass erasure drain and can be freed, see trimShard().
+///
+/// All shards share copies of Allocator, e.g. a BlockPoolAllocator so that
+/// every shard takes its blocks from the same per-device pool.
+///
+/// The element destructor runs while its shard is locked. It may release
+/// elements of other ConcurrentHives (WebGPU objects only reference objects of
+/// other types, e.g. TextureView -> Texture, so locks are always taken in the
+/// same order) but must not release elements of the same ConcurrentHive.
+template <typename T, std::size_t ShardCount = 32,
+          typename Allocator = std::allocator<T>, typename Context = void>
+class ConcurrentHive {
+public:
+  using hive_type = plf::hive<T, Allocator>;
+
+  static_assert(ShardCount > 0);
+  static_assert(plf::hive_block_traits<T>::block_alignment != 0,
+                "ConcurrentHive requires plf::hive_block_traits<T> to enable "
+                "aligned blocks");
+
+  ConcurrentHive() : ConcurrentHive(Allocator{}) {}
+
+  // context is returned by contextOf() for every element, e.g. the device
+  // owning this ConcurrentHive
+  explicit ConcurrentHive(const Allocator &allocator,
+                          Context *context = nullptr)
+      : mShards{makeShards(std::make_index_sequence<ShardCount>{}, context,
+                           allocator)} {}
+
+  // Every shard uses blockLimits for the capacity of its blocks. Only possible
+  // at construction: plf::hive::reshape would have to move the elements.
+  ConcurrentHive(plf::hive_limits blockLimits, const Allocator &allocator,
+                 Context *context = nullptr)
+      : mShards{makeShards(std::make_index_sequence<ShardCount>{}, context,
+                           blockLimits, allocator)} {}
+
+#pragma region noncopyable
+  ConcurrentHive(const ConcurrentHive &) = delete;
+  ConcurrentHive &operator=(const ConcurrentHive &) = delete;
+  ConcurrentHive(ConcurrentHive &&) = delete;
+  ConcurrentHive &operator=(ConcurrentHive &&) = delete;
+#pragma endregion noncopyable
+
+  template <typename... Args> T *emplace(Args &&...args) {
+    Shard &shard =
+        mShards[concurrent_hive_detail::threadIndex() % ShardCount];
+    ShardLock lock{shard};
+
+    T *element = &(*shard.emplace_dense(std::forward<Args>(args)...));
+    shard.peakSize = std::max(shard.peakSize, shard.size());
+
+    return element;
+  }
+
+  // Construct n elements adjacent in memory with a single lock, see
+  // plf::hive::emplace_contiguous, and write a pointer to each of them to out.
+  // out is written while the shard is locked, so assigning to it must not
+  // release elements of this ConcurrentHive.
+  template <typename OutputIt, typename... Args>
+  OutputIt emplaceContiguous(std::size_t n, OutputIt out,
+                             const Args &...args) {
+    Shard &shard =
+        mShards[concurrent_hive_detail::threadIndex() % ShardCount];
+    ShardLock lock{shard};
+
+    auto it = shard.emplace_contiguous(n, args...);
+    shard.peakSize = std::max(shard.peakSize, shard.size());
+
+    for (std::size_t i = 0; i < n; ++i, ++it) {
+      *out++ = &(*it);
+    }
+
+    return out;
+  }
+
+  // Static: the element's block leads to its shard, whichever ConcurrentHive
+  // it belongs to
+  static void erase(const T *p) {
+    Shard &shard = owningShard(p);
+    ShardLock lock{shard};
+
+    shard.erase_pointer(p);
+  }
+
+  // Erase many elements at once, locking each affected shard once, see
+  // plf::hive::erase_pointers. Reorders the span. The elements may belong to
+  // different ConcurrentHives.
+  static void eraseMany(std::span<T *> elements) {
+    std::sort(elements.begin(), elements.end(),
+              [](const T *a, const T *b) {
+                return std::less<const hive_type *>{}(hive_type::get_owner(a),
+                                                      hive_type::get_owner(b));
+              });
+
+    for (auto runBegin = elements.begin(); runBegin != elements.end();) {
+      const hive_type *owner = hive_type::get_owner(*runBegin);
+      const auto runEnd =
+          std::find_if(runBegin, elements.end(), [owner](const T *p) {
+            return hive_type::get_owner(p) != owner;
+          });
+
+      Shard &shard = owningShard(*runBegin);
+      ShardLock lock{shard};
+      shard.erase_pointers(runBegin, runEnd);
+
+      runBegin = runEnd;
+    }
+  }
+
+  // Destroy every element, keeping the blocks for reuse. As with erase, the
+  // element destructors must not release elements of this ConcurrentHive.
+  void clear() {
+    for (Shard &shard : mShards) {
+      ShardLock lock{shard};
+      shard.clear();
+    }
+  }
+
+  // Shards are locked one at a time while they are visited, so no element can
+  // be erased while the callback sees it. Elements created or erased
+  // concurrently in other shards may or may not be visited.
+  template <typename F> void forEach(F &&f) {
+    for (Shard &shard : mShards) {
+      ShardLock lock{shard};
+
+      shard.for_each_group_range(
+          [&f](const typename hive_type::group_range &block) {
+            block.for_each(f);
+          });
+    }
+  }
+
+  // Like forEach, but f(slot_metadata_type &) only gets the per-slot metadata
+  // from plf::hive_block_traits<T>::slot_metadata_type, without touching the
+  // elements.
+  template <typename F> void forEachSlotMetadata(F &&f) {
+    for (Shard &shard : mShards) {
+      ShardLock lock{shard};
+
+      shard.for_each_slot_metadata(
+          [&f](auto &metadata, T *) {
+            f(metadata);
+          });
+    }
+  }
+
+  // Like forEach, but split at block boundaries and run on pool, so f is
+  // called from several threads at once (for different elements). Every
+  // shard stays locked until all elements are visited: f must not create or
+  // release elements of this ConcurrentHive.
+  template <typename F> void parallelForEach(WorkStealingPool &pool, F &&f) {
+    forEachBlockRange(pool, [&f](const typename hive_type::group_range &block) {
+      block.for_each(f);
+    });
+  }
+
+  // Like forEachSlotMetadata, in parallel as parallelForEach. This is the one
+  // for mass state changes, e.g. marking every texture destroyed on device
+  // loss.
+  template <typename F>
+  void parallelForEachSlotMetadata(WorkStealingPool &pool, F &&f) {
+    forEachBlockRange(pool, [&f](const typename hive_type::group_range &block) {
+      block.for_each_slot_metadata([&f](auto &metadata, T *) { f(metadata); });
+    });
+  }
+
+  // Reserve room for shardCapacities[i] elements in shard i, e.g. the
+  // peakShardSizes() of a previous run. Shards past the end of the span are
+  // left as they are.
+  void reserve(std::span<const std::size_t> shardCapacities) {
+    const std::size_t count = std::min(shardCapacities.size(), ShardCount);
+
+    for (std::size_t i = 0; i < count; ++i) {
+      ShardLock lock{mShards[i]};
+      mShards[i].reserve(shardCapacities[i]);
+      mShards[i].reservedCapacity = shardCapacities[i];
+    }
+  }
+
+  static constexpr std::size_t shardCount() noexcept { return ShardCount; }
+
+  // Free the unused blocks of shard index beyond retainFactor times its
+  // element count, though never below what reserve() asked for. Elements are
+  // never moved, so only blocks that are entirely empty are freed. Cheap
+  // enough to be called for one shard at a time from a time-budgeted
+  // schedule, see TrimScheduler.
+  void trimShard(std::size_t index, std::size_t retainFactor) {
+    Shard &shard = mShards[index];
+    ShardLock lock{shard};
+
+    const std::size_t retain =
+        std::max(shard.size() * retainFactor, shard.reservedCapacity);
+    if (retain == 0) {
+      shard.trim_capacity();
+    } else {
+      shard.trim_capacity(retain);
+    }
+  }
+
+  struct Occupancy {
+    std::size_t size = 0;
+    // Element slots in all allocated blocks, used, erased and unused
+    std::size_t capacity = 0;
+  };
+
+  Occupancy occupancy() const {
+    Occupancy occupancy;
+
+    for (const Shard &shard : mShards) {
+      ShardLock lock{shard};
+      occupancy.size += shard.size();
+      occupancy.capacity += shard.capacity();
+    }
+
+    return occupancy;
+  }
+
+  // f(size, capacity) for every block holding elements, see
+  // plf::hive::for_each_group_occupancy. Shards are locked one at a time.
+  template <typename F> void forEachBlockOccupancy(F &&f) const {
+    for (const Shard &shard : mShards) {
+      ShardLock lock{shard};
+      shard.for_each_group_occupancy(f);
+    }
+  }
+
+  // The most elements each shard held at any time so far
+  std::vector<std::size_t> peakShardSizes() const {
+    std::vector<std::size_t> peaks;
+    peaks.reserve(ShardCount);
+
+    for (const Shard &shard : mShards) {
+      ShardLock lock{shard};
+      peaks.push_back(shard.peakSize);
+    }
+
+    return peaks;
+  }
+
+  struct LockStats {
+    std::uint64_t acquisitions = 0;
+    // Acquisitions that found the shard already locked by another thread
+    std::uint64_t contended = 0;
+    // Total time shards were held locked
+    std::chrono::nanoseconds held{0};
+  };
+
+  // Summed over all shards. Always zero unless CONCURRENT_HIVE_LOCK_STATS is
+  // enabled.
+  LockStats lockStats() const {
+    LockStats stats;
+
+    for (const Shard &shard : mShards) {
+      // Not counted itself
+      std::lock_guard lock{shard.mutex};
+      stats.acquisitions += shard.lockStats.acquisitions;
+      stats.contended += shard.lockStats.contended;
+      stats.held += shard.lockStats.held;
+    }
+
+    return stats;
+  }
+
+  // The context the ConcurrentHive owning element was constructed with
+  static Context *contextOf(const T *element) noexcept {
+    return owningShard(element).context;
+  }
+
+  std::size_t size() const {
+    std::size_t size = 0;
+
+    for (const Shard &shard : mShards) {
+      ShardLock lock{shard};
+      size += shard.size();
+    }
+
+    return size;
+  }
+
+private:
+  // Keep every shard on its own cache lines so that threads working on
+  // different shards do not false-share mutexes or hive bookkeeping.
+  //
+  // A shard is the plf::hive, rather than holding one, so that the owner
+  // pointer in an element's block header can be cast back to it.
+  struct alignas(64) Shard : hive_type {
+    // Followed by the arguments of the plf::hive constructor
+    template <typename... Args>
+    explicit Shard(Context *context, const Args &...args)
+        : hive_type{args...}, context{context} {}
+
+    Context *const context;
+    mutable std::mutex mutex;
+    // Updated under the lock by every emplace, so it costs next to nothing
+    std::size_t peakSize = 0;
+    std::size_t reservedCapacity = 0;
+    // Updated under the lock, see ShardLock
+    mutable LockStats lockStats;
+  };
+
+  // std::lock_guard on the shard's mutex, recording LockStats if enabled
+  class ShardLock {
+  public:
+    explicit ShardLock(const Shard &shard) : mShard{shard} {
+      if constexpr (CONCURRENT_HIVE_LOCK_STATS) {
+        const bool contended = !shard.mutex.try_lock();
+        if (contended) {
+          shard.mutex.lock();
+        }
+
+        ++shard.lockStats.acquisitions;
+        shard.lockStats.contended += contended;
+        mLockedAt = std::chrono::steady_clock::now();
+      } else {
+        shard.mutex.lock();
+      }
+    }
+
+    ~ShardLock() {
+      if constexpr (CONCURRENT_HIVE_LOCK_STATS) {
+        mShard.lockStats.held += std::chrono::steady_clock::now() - mLockedAt;
+      }
+
+      mShard.mutex.unlock();
+    }
+
+#pragma region noncopyable
+    ShardLock(const ShardLock &) = delete;
+    ShardLock &operator=(const ShardLock &) = delete;
+    ShardLock(ShardLock &&) = delete;
+    ShardLock &operator=(ShardLock &&) = delete;
+#pragma endregion noncopyable
+
+  private:
+    const Shard &mShard;
+    std::chrono::steady_clock::time_point mLockedAt;
+  };
+
+  template <std::size_t... Index, typename... Args>
+  static std::array<Shard, ShardCount>
+  makeShards(std::index_sequence<Index...>, Context *context,
+             const Args &...args) {
+    return {{((void)Index, Shard{context, args...})...}};
+  }
+
+  // Run f(group_range) for every block of every shard on pool, with all
+  // shards locked
+  template <typename F> void forEachBlockRange(WorkStealingPool &pool, F &&f) {
+    std::array<std::unique_lock<std::mutex>, ShardCount> locks;
+    std::vector<typename hive_type::group_range> blocks;
+
+    // Always in index order, other threads lock at most one shard
+    for (std::size_t i = 0; i < ShardCount; ++i) {
+      locks[i] = std::unique_lock{mShards[i].mutex};
+      mShards[i].for_each_group_range(
+          [&blocks](const typename hive_type::group_range &block) {
+            blocks.push_back(block);
+          });
+    }
+
+    pool.parallelFor(blocks.size(),
+                     [&](std::size_t index) { f(blocks[index]); });
+  }
+
+  // p has to be an element of a ConcurrentHive of this type, so the hive its
+  // block header points to is one of the ConcurrentHive's shards
+  static Shard &owningShard(const T *p) noexcept {
+    return static_cast<Shard &>(const_cast<hive_type &>(
+        *hive_type::get_owner(p)));
+  }
+
+  std::array<Shard, ShardCount> mShards;
+};
+
+#endif // CONCURRENT_HIVE_HPP_
@@ -0,0 +1,211 @@
+#ifndef DEFERRED_DESTRUCTION_HPP_
+#define DEFERRED_DESTRUCTION_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace deferred_destruction_detail {
+constexpr std::size_t kScanWidth = 4;
+
+// Bit i is set if indices[i] <= completedSubmissionIndex
+inline unsigned retiredMask(const std::uint64_t *indices,
+                            std::uint64_t completedSubmissionIndex) noexcept {
+#if defined(__AVX2__)
+  // There is only a signed 64-bit compare, flipping the sign bit of both
+  // sides makes it unsigned
+  const __m256i signBit =
+      _mm256_set1_epi64x(static_cast<long long>(0x8000'0000'0000'0000ull));
+  const __m256i values = _mm256_xor_si256(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices)),
+      signBit);
+  const __m256i completed = _mm256_xor_si256(
+      _mm256_set1_epi64x(static_cast<long long>(completedSubmissionIndex)),
+      signBit);
+  const __m256i pending = _mm256_cmpgt_epi64(values, completed);
+
+  return ~static_cast<unsigned>(
+             _mm256_movemask_pd(_mm256_castsi256_pd(pending))) &
+         0xFu;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint64x2_t completed = vdupq_n_u64(completedSubmissionIndex);
+  const uint64x2_t low = vcleq_u64(vld1q_u64(indices), completed);
+  const uint64x2_t high = vcleq_u64(vld1q_u64(indices + 2), completed);
+
+  return static_cast<unsigned>((vgetq_lane_u64(low, 0) & 1) |
+                               (vgetq_lane_u64(low, 1) & 2) |
+                               (vgetq_lane_u64(high, 0) & 4) |
+                               (vgetq_lane_u64(high, 1) & 8));
+#else
+  unsigned mask = 0;
+  for (std::size_t i = 0; i < kScanWidth; ++i) {
+    mask |= static_cast<unsigned>(indices[i] <= completedSubmissionIndex) << i;
+  }
+
+  return mask;
+#endif
+}
+} // namespace deferred_destruction_detail
+
+/// GPU objects can't be freed when destroy() is called or the CPU object dies:
+/// submissions that are still executing may use them. Instead they are pushed
+/// here together with the submission index after which the GPU no longer
+/// needs them, and the queue submit path collects them once the GPU timeline
+/// (e.g. a timeline semaphore or a fence per submission) has passed it.
+///
+/// - push() is lock-free and may be called from any thread, including
+///   destructors running while a ConcurrentHive shard is locked
+/// - collect() must only be called from a single thread at a time, normally
+///   the one submitting to the queue. It hands all retired entries to the
+///   callback as one batch so they can be freed with as few driver calls as
+///   possible.
+template <typename T> class DeferredDestructionQueue {
+public:
+  DeferredDestructionQueue() = default;
+
+#pragma region noncopyable
+  DeferredDestructionQueue(const DeferredDestructionQueue &) = delete;
+  DeferredDestructionQueue &
+  operator=(const DeferredDestructionQueue &) = delete;
+  DeferredDestructionQueue(DeferredDestructionQueue &&) = delete;
+  DeferredDestructionQueue &operator=(DeferredDestructionQueue &&) = delete;
+#pragma endregion noncopyable
+
+  ~DeferredDestructionQueue() {
+    deleteNodes(mHead.exchange(nullptr, std::memory_order_acquire));
+  }
+
+  void push(std::uint64_t submissionIndex, T value) {
+    Node *node = new Node{{submissionIndex, std::move(value)},
+                          mHead.load(std::memory_order_relaxed)};
+
+    while (!mHead.compare_exchange_weak(node->next, node,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+    }
+  }
+
+  // Call destroyBatch(std::span<T>) once with every entry whose submission
+  // index is <= completedSubmissionIndex. Returns the number of entries
+  // destroyed.
+  template <typename F>
+  std::size_t collect(std::uint64_t completedSubmissionIndex,
+                      F &&destroyBatch) {
+    using deferred_destruction_detail::kScanWidth;
+
+    takePushed();
+
+    mBatch.clear();
+    const std::size_t count = mPendingIndices.size();
+    std::size_t kept = 0;
+    std::size_t i = 0;
+
+    // Most entries are usually still pending. Their indices are compared
+    // kScanWidth at a time and, as long as nothing was retired before them,
+    // the values aren't even touched.
+    for (; i + kScanWidth <= count; i += kScanWidth) {
+      const unsigned retired = deferred_destruction_detail::retiredMask(
+          &mPendingIndices[i], completedSubmissionIndex);
+
+      if (retired == 0 && kept == i) {
+        kept += kScanWidth;
+        continue;
+      }
+
+      for (std::size_t lane = 0; lane < kScanWidth; ++lane) {
+        retireOrKeep(i + lane, (retired >> lane) & 1u, kept);
+      }
+    }
+
+    for (; i < count; ++i) {
+      retireOrKeep(i, mPendingIndices[i] <= completedSubmissionIndex, kept);
+    }
+
+    mPendingIndices.resize(kept);
+    mPendingValues.erase(mPendingValues.begin() + kept, mPendingValues.end());
+
+    if (!mBatch.empty()) {
+      destroyBatch(std::span<T>{mBatch});
+    }
+
+    return mBatch.size();
+  }
+
+  // Destroy everything regardless of submission index, e.g. after waiting for
+  // the device to become idle during teardown.
+  template <typename F> std::size_t flush(F &&destroyBatch) {
+    return collect(std::numeric_limits<std::uint64_t>::max(),
+                   std::forward<F>(destroyBatch));
+  }
+
+private:
+  struct Entry {
+    std::uint64_t submissionIndex;
+    T value;
+  };
+
+  struct Node {
+    Entry entry;
+    Node *next;
+  };
+
+  // Move everything pushed so far into the pending arrays, oldest first.
+  void takePushed() {
+    Node *node = mHead.exchange(nullptr, std::memory_order_acquire);
+    const std::size_t begin = mPendingIndices.size();
+
+    while (node != nullptr) {
+      Node *next = node->next;
+      mPendingIndices.push_back(node->entry.submissionIndex);
+      mPendingValues.push_back(std::move(node->entry.value));
+      delete node;
+      node = next;
+    }
+
+    // The stack hands entries out newest first
+    std::reverse(mPendingIndices.begin() + begin, mPendingIndices.end());
+    std::reverse(mPendingValues.begin() + begin, mPendingValues.end());
+  }
+
+  void retireOrKeep(std::size_t i, bool retired, std::size_t &kept) {
+    if (retired) {
+      mBatch.push_back(std::move(mPendingValues[i]));
+      return;
+    }
+
+    if (kept != i) {
+      mPendingIndices[kept] = mPendingIndices[i];
+      mPendingValues[kept] = std::move(mPendingValues[i]);
+    }
+    ++kept;
+  }
+
+  static void deleteNodes(Node *node) {
+    while (node != nullptr) {
+      Node *next = node->next;
+      delete node;
+      node = next;
+    }
+  }
+
+  std::atomic<Node *> mHead{nullptr};
+
+  // Only touched by the collecting thread. Indices and values are kept apart
+  // so that collect() scans a dense array of indices.
+  std::vector<std::uint64_t> mPendingIndices;
+  std::vector<T> mPendingValues;
+  std::vector<T> mBatch;
+};
+
+#endif // DEFERRED_DESTRUCTION_HPP_
@@ -0,0 +1,159 @@
+#ifndef GENERATIONAL_HANDLE_HPP_
+#define GENERATIONAL_HANDLE_HPP_
+
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+/// 64-bit handle to a T: a slot index in the lower 32 bits and the slot's
+/// generation in the upper 32 bits. Unlike a raw pointer into a plf::hive, a
+/// handle outliving its object does not alias whatever object reuses the
+/// storage: the slot's generation has moved on and resolving it fails. Being
+/// 8 bytes it can also be stored in GPU-visible tables and command streams.
+///
+/// The value 0 is never handed out and means "no object".
+template <typename T> struct Handle {
+  std::uint64_t value = 0;
+
+  std::uint32_t index() const noexcept {
+    return static_cast<std::uint32_t>(value);
+  }
+  std::uint32_t generation() const noexcept {
+    return static_cast<std::uint32_t>(value >> 32);
+  }
+
+  explicit operator bool() const noexcept { return value != 0; }
+  friend bool operator==(Handle, Handle) = default;
+};
+
+/// Maps handles to objects living elsewhere (e.g. in a ConcurrentHive).
+///
+/// Slots are allocated in blocks of BlockSize that are never freed or moved
+/// while the table exists, so resolve() is lock-free and O(1): one load for
+/// the block, then the slot's generation and object pointer next to each
+/// other, no hashing. insert() and remove() take a mutex to manage the free
+/// slots.
+///
+/// resolve() only guards against stale handles, it doesn't keep the object
+/// alive: the caller needs to hold a reference, as with raw pointers.
+template <typename T, std::size_t BlockSize = 1024, std::size_t MaxBlocks = 4096>
+class HandleTable {
+public:
+  HandleTable() = default;
+
+#pragma region noncopyable
+  HandleTable(const HandleTable &) = delete;
+  HandleTable &operator=(const HandleTable &) = delete;
+  HandleTable(HandleTable &&) = delete;
+  HandleTable &operator=(HandleTable &&) = delete;
+#pragma endregion noncopyable
+
+  Handle<T> insert(T *object) {
+    std::lock_guard lock{mMutex};
+    std::uint32_t index;
+
+    if (!mFreeIndices.empty()) {
+      index = mFreeIndices.back();
+      mFreeIndices.pop_back();
+    } else {
+      if (mSlotCount == BlockSize * MaxBlocks) {
+        throw std::length_error("HandleTable is full");
+      }
+
+      index = static_cast<std::uint32_t>(mSlotCount++);
+
+      if (index % BlockSize == 0) {
+        mBlockStorage.push_back(std::make_unique<Slot[]>(BlockSize));
+        mBlocks[index / BlockSize].store(mBlockStorage.back().get(),
+                                         std::memory_order_release);
+      }
+    }
+
+    Slot &slot = slotAt(index);
+    slot.object.store(object, std::memory_order_release);
+
+    return makeHandle(index,
+                      slot.generation.load(std::memory_order_relaxed));
+  }
+
+  T *resolve(Handle<T> handle) const noexcept {
+    const std::uint32_t index = handle.index();
+    if (index >= BlockSize * MaxBlocks) {
+      return nullptr;
+    }
+
+    const Slot *block =
+        mBlocks[index / BlockSize].load(std::memory_order_acquire);
+    if (block == nullptr) {
+      return nullptr;
+    }
+
+    const Slot &slot = block[index % BlockSize];
+    if (slot.generation.load(std::memory_order_acquire) !=
+        handle.generation()) {
+      return nullptr;
+    }
+
+    T *object = slot.object.load(std::memory_order_acquire);
+
+    // The slot may have been removed and reused since the first check
+    if (slot.generation.load(std::memory_order_relaxed) !=
+        handle.generation()) {
+      return nullptr;
+    }
+
+    return object;
+  }
+
+  // Invalidate the handle. Its slot is reused by a later insert() with the
+  // next generation.
+  void remove(Handle<T> handle) {
+    assert(resolve(handle) != nullptr);
+    Slot &slot = slotAt(handle.index());
+
+    // Generation 0 is skipped so that no handle ever equals 0
+    std::uint32_t next = handle.generation() + 1;
+    if (next == 0) {
+      next = 1;
+    }
+
+    // The generation changes before the pointer, see resolve()
+    slot.generation.store(next, std::memory_order_relaxed);
+    slot.object.store(nullptr, std::memory_order_release);
+
+    std::lock_guard lock{mMutex};
+    mFreeIndices.push_back(handle.index());
+  }
+
+private:
+  struct Slot {
+    std::atomic<std::uint32_t> generation{1};
+    std::atomic<T *> object{nullptr};
+  };
+
+  static Handle<T> makeHandle(std::uint32_t index,
+                              std::uint32_t generation) noexcept {
+    return Handle<T>{(std::uint64_t{generation} << 32) | index};
+  }
+
+  Slot &slotAt(std::uint32_t index) const noexcept {
+    return mBlocks[index / BlockSize].load(std::memory_order_relaxed)
+        [index % BlockSize];
+  }
+
+  std::array<std::atomic<Slot *>, MaxBlocks> mBlocks{};
+
+  // Only touched with mMutex locked
+  std::mutex mMutex;
+  std::vector<std::unique_ptr<Slot[]>> mBlockStorage;
+  std::vector<std::uint32_t> mFreeIndices;
+  std::size_t mSlotCount = 0;
+};
+
+#endif // GENERATIONAL_HANDLE_HPP_
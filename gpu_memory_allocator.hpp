@@ -0,0 +1,456 @@
+#ifndef GPU_MEMORY_ALLOCATOR_HPP_
+#define GPU_MEMORY_ALLOCATOR_HPP_
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/// Range of GPU memory handed out by GpuMemoryAllocator, what a texture binds
+/// its VkImage to. Empty (memory == 0) when default constructed.
+struct GpuMemoryAllocation {
+  enum class Kind : std::uint8_t { None, Slab, Buddy, Dedicated };
+
+  // VkDeviceMemory stand-in
+  std::uint64_t memory = 0;
+  std::uint64_t offset = 0;
+  // As allocated, the requested size rounded up to the size class
+  std::uint64_t size = 0;
+  // Where it came from and the index of the slab, block or dedicated
+  // allocation there, so freeing needs no lookup
+  Kind kind = Kind::None;
+  std::uint32_t index = 0;
+
+  explicit operator bool() const noexcept { return memory != 0; }
+};
+
+/// Sub-allocates GPU memory of one memory type, so that creating a texture
+/// costs a few bit operations instead of a vkAllocateMemory, whose count
+/// drivers limit (maxMemoryAllocationCount is 4096 on many) and which is
+/// slow. Three tiers by size:
+/// - up to kMaxSlabClassSize: power of two size classes, each carving
+///   kSlabSize slabs into equal slots handed out from a free list
+/// - up to Options::dedicatedThreshold: a buddy allocator over blocks of
+///   Options::blockSize, each one vkAllocateMemory; slabs come from here too
+/// - larger: one vkAllocateMemory each, which drivers prefer for large render
+///   targets anyway (VK_KHR_dedicated_allocation)
+///
+/// Every range is aligned to its size class, so any power of two alignment
+/// up to the size works. Blocks and slabs emptied by free() are kept until
+/// releaseFreeMemory(), see TrimScheduler.
+///
+/// Thread-safe, guarded by one mutex. freeMany() takes a range so that the
+/// deferred destruction queue returns a whole batch under one lock.
+class GpuMemoryAllocator {
+public:
+  static constexpr std::uint64_t kMinSlabClassSize = 4 * 1024;
+  static constexpr std::uint64_t kMaxSlabClassSize = 256 * 1024;
+  static constexpr std::uint64_t kSlabSize = 1024 * 1024;
+  // Smallest buddy, the blocks are split at most down to this
+  static constexpr std::uint64_t kMinBuddySize = 64 * 1024;
+
+  struct Options {
+    // Size of every vkAllocateMemory sub-allocated from, a power of two
+    std::uint64_t blockSize = 64 * 1024 * 1024;
+    // Allocations above get memory of their own, at most blockSize
+    std::uint64_t dedicatedThreshold = 16 * 1024 * 1024;
+  };
+
+  struct Stats {
+    // vkAllocateMemory calls so far, and the allocations currently alive
+    std::uint64_t driverAllocations = 0;
+    std::size_t driverMemoryCount = 0;
+    // Memory allocated from the driver, and how much of it is handed out
+    std::uint64_t reservedBytes = 0;
+    std::uint64_t usedBytes = 0;
+  };
+
+  GpuMemoryAllocator() : GpuMemoryAllocator(Options{}) {}
+
+  explicit GpuMemoryAllocator(const Options &options)
+      : mBlockSize{options.blockSize},
+        mDedicatedThreshold{
+            std::min(options.dedicatedThreshold, options.blockSize)},
+        mBlockOrder{order(options.blockSize)} {
+    assert(std::has_single_bit(mBlockSize) && mBlockSize >= kSlabSize);
+  }
+
+#pragma region noncopyable
+  GpuMemoryAllocator(const GpuMemoryAllocator &) = delete;
+  GpuMemoryAllocator &operator=(const GpuMemoryAllocator &) = delete;
+  GpuMemoryAllocator(GpuMemoryAllocator &&) = delete;
+  GpuMemoryAllocator &operator=(GpuMemoryAllocator &&) = delete;
+#pragma endregion noncopyable
+
+  ~GpuMemoryAllocator() {
+    // Whatever is still allocated goes with its driver memory
+    for (const std::unique_ptr<Block> &block : mBlocks) {
+      if (block) {
+        freeDriverMemory(block->memory, mBlockSize);
+      }
+    }
+    for (const Dedicated &dedicated : mDedicated) {
+      if (dedicated.memory != 0) {
+        freeDriverMemory(dedicated.memory, dedicated.size);
+      }
+    }
+  }
+
+  // size bytes aligned to alignment, a power of two
+  GpuMemoryAllocation allocate(std::uint64_t size, std::uint64_t alignment) {
+    assert(std::has_single_bit(alignment));
+    size = std::max({size, alignment, std::uint64_t{1}});
+
+    std::lock_guard lock{mMutex};
+
+    GpuMemoryAllocation allocation;
+    if (size <= kMaxSlabClassSize) {
+      allocation =
+          allocateFromSlab(std::bit_ceil(std::max(size, kMinSlabClassSize)));
+    } else if (size <= mDedicatedThreshold) {
+      allocation = allocateBuddy(std::max(std::bit_ceil(size), kMinBuddySize));
+    } else {
+      allocation = allocateDedicated(size);
+    }
+
+    mUsedBytes += allocation.size;
+    return allocation;
+  }
+
+  // Return allocations, any range of GpuMemoryAllocation. The GPU must be
+  // done with them.
+  template <typename Range> void freeMany(Range &&allocations) {
+    std::lock_guard lock{mMutex};
+
+    for (const GpuMemoryAllocation &allocation : allocations) {
+      freeLocked(allocation);
+    }
+  }
+
+  void free(const GpuMemoryAllocation &allocation) {
+    std::lock_guard lock{mMutex};
+    freeLocked(allocation);
+  }
+
+  // Give empty slabs back to their blocks and empty blocks back to the
+  // driver. Returns the number of vkFreeMemory calls.
+  std::size_t releaseFreeMemory() {
+    std::lock_guard lock{mMutex};
+
+    for (std::size_t i = 0; i < mSlabs.size(); ++i) {
+      Slab &slab = mSlabs[i];
+      if (slab.memory != 0 && slab.used == 0) {
+        std::erase(mClasses[slab.sizeClass].partialSlabs,
+                   static_cast<std::uint32_t>(i));
+        freeBuddy(slab.block, slab.offset, order(kSlabSize));
+        slab = Slab{};
+        mFreeSlabIndices.push_back(static_cast<std::uint32_t>(i));
+      }
+    }
+
+    std::size_t released = 0;
+    for (std::unique_ptr<Block> &block : mBlocks) {
+      if (block && block->freeOrders == (std::uint64_t{1} << mBlockOrder)) {
+        freeDriverMemory(block->memory, mBlockSize);
+        block.reset();
+        ++released;
+      }
+    }
+
+    return released;
+  }
+
+  Stats stats() const {
+    std::lock_guard lock{mMutex};
+    return {mDriverAllocations, mDriverMemoryCount, mReservedBytes,
+            mUsedBytes};
+  }
+
+private:
+  static constexpr std::size_t kSlabClassCount =
+      std::countr_zero(kMaxSlabClassSize) -
+      std::countr_zero(kMinSlabClassSize) + 1;
+
+  // Buddy allocator over one vkAllocateMemory. Order k nodes are 2^k bytes,
+  // free[k] has bit n set if the node at offset n << k is free, and bit k of
+  // freeOrders says whether free[k] has any, so finding a free node of at
+  // least some order is a mask and a bit scan.
+  struct Block {
+    std::uint64_t memory = 0;
+    std::uint64_t freeOrders = 0;
+    std::vector<std::vector<std::uint64_t>> free;
+  };
+
+  // kSlabSize buddy of a block, carved into slots of one size class
+  struct Slab {
+    std::uint64_t memory = 0;
+    std::uint32_t block = 0;
+    std::uint64_t offset = 0;
+    std::size_t sizeClass = 0;
+    std::uint32_t used = 0;
+    // Slot indices not handed out
+    std::vector<std::uint32_t> freeSlots;
+  };
+
+  struct SizeClass {
+    // Slabs with free slots, the last one is allocated from
+    std::vector<std::uint32_t> partialSlabs;
+  };
+
+  struct Dedicated {
+    std::uint64_t memory = 0;
+    std::uint64_t size = 0;
+  };
+
+  static std::uint32_t order(std::uint64_t size) noexcept {
+    return static_cast<std::uint32_t>(std::countr_zero(size));
+  }
+
+  static bool testBit(const std::vector<std::uint64_t> &bits,
+                      std::uint64_t n) noexcept {
+    return (bits[n / 64] >> (n % 64)) & 1;
+  }
+
+  void setFree(Block &block, std::uint32_t nodeOrder, std::uint64_t node,
+               bool free) noexcept {
+    std::vector<std::uint64_t> &bits = block.free[nodeOrder];
+    const std::uint64_t bit = std::uint64_t{1} << (node % 64);
+    if (free) {
+      bits[node / 64] |= bit;
+      block.freeOrders |= std::uint64_t{1} << nodeOrder;
+      return;
+    }
+
+    bits[node / 64] &= ~bit;
+    if (std::none_of(bits.begin(), bits.end(),
+                     [](std::uint64_t word) { return word != 0; })) {
+      block.freeOrders &= ~(std::uint64_t{1} << nodeOrder);
+    }
+  }
+
+  // vkAllocateMemory stand-in
+  std::uint64_t allocateDriverMemory(std::uint64_t size) noexcept {
+    ++mDriverAllocations;
+    ++mDriverMemoryCount;
+    mReservedBytes += size;
+
+    return mNextMemory++;
+  }
+
+  // vkFreeMemory stand-in
+  void freeDriverMemory(std::uint64_t, std::uint64_t size) noexcept {
+    --mDriverMemoryCount;
+    mReservedBytes -= size;
+  }
+
+  GpuMemoryAllocation allocateBuddy(std::uint64_t size) {
+    const std::uint32_t wanted = order(size);
+
+    std::uint32_t blockIndex = 0;
+    for (; blockIndex < mBlocks.size(); ++blockIndex) {
+      if (mBlocks[blockIndex] &&
+          (mBlocks[blockIndex]->freeOrders >> wanted) != 0) {
+        break;
+      }
+    }
+    if (blockIndex == mBlocks.size()) {
+      blockIndex = addBlock();
+    }
+
+    Block &block = *mBlocks[blockIndex];
+    std::uint32_t nodeOrder =
+        wanted + static_cast<std::uint32_t>(
+                     std::countr_zero(block.freeOrders >> wanted));
+
+    // First free node of nodeOrder, split down to the wanted order keeping
+    // the lower half each time
+    const std::vector<std::uint64_t> &bits = block.free[nodeOrder];
+    const auto word = static_cast<std::uint64_t>(
+        std::find_if(bits.begin(), bits.end(),
+                     [](std::uint64_t word) { return word != 0; }) -
+        bits.begin());
+    std::uint64_t node = word * 64 + std::countr_zero(bits[word]);
+    setFree(block, nodeOrder, node, false);
+
+    for (; nodeOrder > wanted; --nodeOrder) {
+      node *= 2;
+      setFree(block, nodeOrder - 1, node + 1, true);
+    }
+
+    GpuMemoryAllocation allocation;
+    allocation.memory = block.memory;
+    allocation.offset = node << wanted;
+    allocation.size = size;
+    allocation.kind = GpuMemoryAllocation::Kind::Buddy;
+    allocation.index = blockIndex;
+
+    return allocation;
+  }
+
+  // Merge with the buddy as long as it is free too
+  void freeBuddy(std::uint32_t blockIndex, std::uint64_t offset,
+                 std::uint32_t nodeOrder) noexcept {
+    Block &block = *mBlocks[blockIndex];
+    std::uint64_t node = offset >> nodeOrder;
+
+    for (; nodeOrder < mBlockOrder &&
+           testBit(block.free[nodeOrder], node ^ 1);
+         ++nodeOrder) {
+      setFree(block, nodeOrder, node ^ 1, false);
+      node /= 2;
+    }
+
+    setFree(block, nodeOrder, node, true);
+  }
+
+  std::uint32_t addBlock() {
+    auto block = std::make_unique<Block>();
+    block->free.resize(mBlockOrder + 1);
+    for (std::uint32_t k = order(kMinBuddySize); k <= mBlockOrder; ++k) {
+      block->free[k].resize(((mBlockSize >> k) + 63) / 64);
+    }
+
+    // Reuse the index of a released block
+    auto slot = std::find(mBlocks.begin(), mBlocks.end(), nullptr);
+    if (slot == mBlocks.end()) {
+      slot = mBlocks.insert(mBlocks.end(), nullptr);
+    }
+
+    block->memory = allocateDriverMemory(mBlockSize);
+    block->free[mBlockOrder][0] = 1;
+    block->freeOrders = std::uint64_t{1} << mBlockOrder;
+    *slot = std::move(block);
+
+    return static_cast<std::uint32_t>(slot - mBlocks.begin());
+  }
+
+  GpuMemoryAllocation allocateFromSlab(std::uint64_t size) {
+    const std::size_t sizeClass = order(size) - order(kMinSlabClassSize);
+    SizeClass &slabs = mClasses[sizeClass];
+
+    if (slabs.partialSlabs.empty()) {
+      slabs.partialSlabs.push_back(addSlab(sizeClass, size));
+    }
+
+    const std::uint32_t slabIndex = slabs.partialSlabs.back();
+    Slab &slab = mSlabs[slabIndex];
+    const std::uint32_t slot = slab.freeSlots.back();
+    slab.freeSlots.pop_back();
+    ++slab.used;
+
+    if (slab.freeSlots.empty()) {
+      slabs.partialSlabs.pop_back();
+    }
+
+    GpuMemoryAllocation allocation;
+    allocation.memory = slab.memory;
+    allocation.offset = slab.offset + slot * size;
+    allocation.size = size;
+    allocation.kind = GpuMemoryAllocation::Kind::Slab;
+    allocation.index = slabIndex;
+
+    return allocation;
+  }
+
+  std::uint32_t addSlab(std::size_t sizeClass, std::uint64_t slotSize) {
+    const GpuMemoryAllocation range = allocateBuddy(kSlabSize);
+
+    std::uint32_t index;
+    if (mFreeSlabIndices.empty()) {
+      index = static_cast<std::uint32_t>(mSlabs.size());
+      mSlabs.emplace_back();
+    } else {
+      index = mFreeSlabIndices.back();
+      mFreeSlabIndices.pop_back();
+    }
+
+    Slab &slab = mSlabs[index];
+    slab.memory = range.memory;
+    slab.block = range.index;
+    slab.offset = range.offset;
+    slab.sizeClass = sizeClass;
+    slab.used = 0;
+
+    // Hand out lower offsets first
+    const auto slotCount = static_cast<std::uint32_t>(kSlabSize / slotSize);
+    slab.freeSlots.resize(slotCount);
+    for (std::uint32_t i = 0; i < slotCount; ++i) {
+      slab.freeSlots[i] = slotCount - 1 - i;
+    }
+
+    return index;
+  }
+
+  GpuMemoryAllocation allocateDedicated(std::uint64_t size) {
+    std::uint32_t index;
+    if (mFreeDedicatedIndices.empty()) {
+      index = static_cast<std::uint32_t>(mDedicated.size());
+      mDedicated.emplace_back();
+    } else {
+      index = mFreeDedicatedIndices.back();
+      mFreeDedicatedIndices.pop_back();
+    }
+
+    mDedicated[index] = {allocateDriverMemory(size), size};
+
+    GpuMemoryAllocation allocation;
+    allocation.memory = mDedicated[index].memory;
+    allocation.size = size;
+    allocation.kind = GpuMemoryAllocation::Kind::Dedicated;
+    allocation.index = index;
+
+    return allocation;
+  }
+
+  void freeLocked(const GpuMemoryAllocation &allocation) {
+    mUsedBytes -= allocation.size;
+
+    switch (allocation.kind) {
+    case GpuMemoryAllocation::Kind::None:
+      break;
+    case GpuMemoryAllocation::Kind::Slab: {
+      Slab &slab = mSlabs[allocation.index];
+      if (slab.freeSlots.empty()) {
+        mClasses[slab.sizeClass].partialSlabs.push_back(allocation.index);
+      }
+      slab.freeSlots.push_back(static_cast<std::uint32_t>(
+          (allocation.offset - slab.offset) / allocation.size));
+      --slab.used;
+      break;
+    }
+    case GpuMemoryAllocation::Kind::Buddy:
+      freeBuddy(allocation.index, allocation.offset, order(allocation.size));
+      break;
+    case GpuMemoryAllocation::Kind::Dedicated:
+      // Nothing to reuse it for, give it back right away
+      freeDriverMemory(allocation.memory, allocation.size);
+      mDedicated[allocation.index] = {};
+      mFreeDedicatedIndices.push_back(allocation.index);
+      break;
+    }
+  }
+
+  const std::uint64_t mBlockSize;
+  const std::uint64_t mDedicatedThreshold;
+  const std::uint32_t mBlockOrder;
+
+  mutable std::mutex mMutex;
+  std::vector<std::unique_ptr<Block>> mBlocks;
+  std::vector<Slab> mSlabs;
+  std::vector<std::uint32_t> mFreeSlabIndices;
+  SizeClass mClasses[kSlabClassCount];
+  std::vector<Dedicated> mDedicated;
+  std::vector<std::uint32_t> mFreeDedicatedIndices;
+
+  std::uint64_t mNextMemory = 1;
+  std::uint64_t mDriverAllocations = 0;
+  std::size_t mDriverMemoryCount = 0;
+  std::uint64_t mReservedBytes = 0;
+  std::uint64_t mUsedBytes = 0;
+};
+
+#endif // GPU_MEMORY_ALLOCATOR_HPP_
@@ -0,0 +1,242 @@
+#ifndef HUB_SNAPSHOT_HPP_
+#define HUB_SNAPSHOT_HPP_
+
+#include "webgpu_resources.hpp"
+#include "workload_profile.hpp"
+
+#include <boost/intrusive_ptr.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <ostream>
+#include <span>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// What a device needs to come back quickly after a restart: the
+/// descriptors of the textures to recreate, the device's WorkloadProfile to
+/// reserve every hive with, and the pipeline cache blob
+/// (vkGetPipelineCacheData) so pipelines compile from cache.
+///
+/// Written with save(), read by open() from a memory-mapped file: the
+/// descriptors are used in place, nothing is parsed but the profile.
+/// Restoring, given WorkStealingPool pool:
+///   HubSnapshot snapshot = HubSnapshot::open(path);
+///   DeviceOptions options;
+///   options.profile = snapshot.profile();
+///   Device device{options};
+///   auto textures = device.restoreTextures(snapshot.textures(), pool);
+///
+/// The file layout is Header, TextureDescriptor[textureCount], the pipeline
+/// cache, then the profile as text. It is only meant to be read by the same
+/// build on the same machine, anything else fails the header check.
+class HubSnapshot {
+public:
+  // Empty, restores nothing
+  HubSnapshot() = default;
+
+  ~HubSnapshot() { unmap(); }
+
+#pragma region noncopyable
+  HubSnapshot(const HubSnapshot &) = delete;
+  HubSnapshot &operator=(const HubSnapshot &) = delete;
+#pragma endregion noncopyable
+
+  HubSnapshot(HubSnapshot &&other) noexcept { *this = std::move(other); }
+
+  HubSnapshot &operator=(HubSnapshot &&other) noexcept {
+    if (this != &other) {
+      unmap();
+      mMapping = std::exchange(other.mMapping, nullptr);
+      mMappingSize = std::exchange(other.mMappingSize, 0);
+      mBuffer = std::move(other.mBuffer);
+      mTextures = std::exchange(other.mTextures, {});
+      mPipelineCache = std::exchange(other.mPipelineCache, {});
+      mProfile = std::move(other.mProfile);
+    }
+
+    return *this;
+  }
+
+  // Write textures (in this order, as restoreTextures returns them) and
+  // device's profile. Resources::liveTextures has all textures in use.
+  static void save(std::ostream &out, const Resources &device,
+                   std::span<const boost::intrusive_ptr<Texture>> textures,
+                   std::span<const std::byte> pipelineCache = {}) {
+    std::ostringstream profile;
+    device.recordWorkloadProfile().save(profile);
+    const std::string profileText = profile.str();
+
+    Header header;
+    header.textureCount = textures.size();
+    header.pipelineCacheSize = pipelineCache.size();
+    header.profileSize = profileText.size();
+    write(out, &header, sizeof(header));
+
+    for (const boost::intrusive_ptr<Texture> &texture : textures) {
+      write(out, &texture->descriptor(), sizeof(TextureDescriptor));
+    }
+
+    write(out, pipelineCache.data(), pipelineCache.size());
+    write(out, profileText.data(), profileText.size());
+  }
+
+  // A missing or broken file gives an empty snapshot, it only costs the warm
+  // start
+  static HubSnapshot open(const char *path) {
+    HubSnapshot snapshot;
+    if (!snapshot.map(path)) {
+      return {};
+    }
+
+    const std::span<const std::byte> file = snapshot.bytes();
+    Header header;
+    if (file.size() < sizeof(header)) {
+      return {};
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    const Header expected;
+    if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+        header.version != expected.version ||
+        header.textureDescriptorSize != expected.textureDescriptorSize) {
+      return {};
+    }
+
+    // Each part is checked against what is left, so no sum can overflow
+    std::span<const std::byte> rest = file.subspan(sizeof(header));
+    if (header.textureCount > rest.size() / sizeof(TextureDescriptor)) {
+      return {};
+    }
+    // TextureDescriptor is trivially copyable and 4-byte aligned, which the
+    // page aligned mapping plus the header keep, so it is read in place
+    snapshot.mTextures = {
+        reinterpret_cast<const TextureDescriptor *>(rest.data()),
+        static_cast<std::size_t>(header.textureCount)};
+    rest = rest.subspan(snapshot.mTextures.size_bytes());
+
+    if (header.pipelineCacheSize > rest.size()) {
+      return {};
+    }
+    snapshot.mPipelineCache = rest.first(header.pipelineCacheSize);
+    rest = rest.subspan(header.pipelineCacheSize);
+
+    if (header.profileSize > rest.size()) {
+      return {};
+    }
+    std::istringstream profile{std::string{
+        reinterpret_cast<const char *>(rest.data()),
+        static_cast<std::size_t>(header.profileSize)}};
+    snapshot.mProfile = WorkloadProfile::load(profile);
+
+    return snapshot;
+  }
+
+  std::span<const TextureDescriptor> textures() const noexcept {
+    return mTextures;
+  }
+
+  // For vkCreatePipelineCache
+  std::span<const std::byte> pipelineCache() const noexcept {
+    return mPipelineCache;
+  }
+
+  const WorkloadProfile &profile() const noexcept { return mProfile; }
+
+private:
+  static_assert(std::is_trivially_copyable_v<TextureDescriptor> &&
+                alignof(TextureDescriptor) <= alignof(std::uint64_t));
+
+  struct Header {
+    char magic[8] = {'W', 'G', 'P', 'U', 'H', 'U', 'B', '\0'};
+    std::uint32_t version = 1;
+    std::uint32_t textureDescriptorSize = sizeof(TextureDescriptor);
+    std::uint64_t textureCount = 0;
+    std::uint64_t pipelineCacheSize = 0;
+    std::uint64_t profileSize = 0;
+  };
+
+  static void write(std::ostream &out, const void *data, std::size_t size) {
+    out.write(static_cast<const char *>(data),
+              static_cast<std::streamsize>(size));
+  }
+
+  bool map(const char *path) {
+#if defined(__unix__) || defined(__APPLE__)
+    const int file = ::open(path, O_RDONLY);
+    if (file < 0) {
+      return false;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size <= 0) {
+      close(file);
+      return false;
+    }
+
+    void *mapping = mmap(nullptr, static_cast<std::size_t>(status.st_size),
+                         PROT_READ, MAP_PRIVATE, file, 0);
+    // The mapping stays valid without the descriptor
+    close(file);
+    if (mapping == MAP_FAILED) {
+      return false;
+    }
+
+    mMapping = mapping;
+    mMappingSize = static_cast<std::size_t>(status.st_size);
+    return true;
+#else
+    // No mmap, read it all instead
+    std::ifstream file{path, std::ios::binary};
+    if (!file) {
+      return false;
+    }
+
+    const std::string contents{std::istreambuf_iterator<char>{file}, {}};
+    mBuffer.resize(contents.size());
+    std::memcpy(mBuffer.data(), contents.data(), contents.size());
+    return !mBuffer.empty();
+#endif
+  }
+
+  void unmap() noexcept {
+#if defined(__unix__) || defined(__APPLE__)
+    if (mMapping != nullptr) {
+      munmap(mMapping, mMappingSize);
+      mMapping = nullptr;
+    }
+#endif
+  }
+
+  std::span<const std::byte> bytes() const noexcept {
+    if (mMapping != nullptr) {
+      return {static_cast<const std::byte *>(mMapping), mMappingSize};
+    }
+
+    return mBuffer;
+  }
+
+  void *mMapping = nullptr;
+  std::size_t mMappingSize = 0;
+  // Used instead of the mapping where there is no mmap. Its heap memory is
+  // aligned enough for TextureDescriptor as well.
+  std::vector<std::byte> mBuffer;
+
+  std::span<const TextureDescriptor> mTextures;
+  std::span<const std::byte> mPipelineCache;
+  WorkloadProfile mProfile;
+};
+
+#endif // HUB_SNAPSHOT_HPP_
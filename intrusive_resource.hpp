@@ -0,0 +1,95 @@
+#ifndef INTRUSIVE_RESOURCE_HPP_
+#define INTRUSIVE_RESOURCE_HPP_
+
+#include "ref_count_policy.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/// CRTP base implementing the intrusive_ptr plumbing every WebGPU object needs,
+/// so that Texture, Buffer, Sampler etc. don't each hand-write the counter and
+/// the intrusive_ptr_add_ref/intrusive_ptr_release pair.
+///
+/// - RefCountPolicy decides how the counter is stored and updated, see
+///   ref_count_policy.hpp
+/// - Hub owns the storage. When the last reference is released the object is
+///   handed to the static Hub::erase(const Derived *), which destroys it and
+///   returns its slot to the storage (e.g. the resource's plf::hive).
+///
+/// There is no virtual dispatch: add_ref and release are hidden friends found
+/// through ADL on Derived and compile to the same inlined code as writing them
+/// by hand.
+template <typename Derived, typename Hub,
+          typename RefCountPolicy = AtomicRefCount>
+class IntrusiveResource {
+public:
+  using ref_count_policy = RefCountPolicy;
+
+  std::uint64_t useCount() const noexcept {
+    return RefCountPolicy::load(mRefCounter);
+  }
+
+protected:
+  IntrusiveResource() noexcept = default;
+  ~IntrusiveResource() = default;
+
+#pragma region noncopyable
+  IntrusiveResource(const IntrusiveResource &) = delete;
+  IntrusiveResource &operator=(const IntrusiveResource &) = delete;
+  IntrusiveResource(IntrusiveResource &&) = delete;
+  IntrusiveResource &operator=(IntrusiveResource &&) = delete;
+#pragma endregion noncopyable
+
+private:
+  mutable typename RefCountPolicy::counter_type mRefCounter{};
+
+  friend void intrusive_ptr_add_ref(const Derived *p) noexcept {
+    RefCountPolicy::increment(p->IntrusiveResource::mRefCounter);
+  }
+
+  static void eraseFromHub(const void *p) {
+    Hub::erase(static_cast<const Derived *>(p));
+  }
+
+  // Drop one reference, returning true if it was the last one
+  static bool releaseReference(const Derived *p) noexcept {
+    auto &counter = p->IntrusiveResource::mRefCounter;
+
+    if constexpr (requires {
+                    RefCountPolicy::decrement(counter, DeferredRelease{});
+                  }) {
+      return RefCountPolicy::decrement(counter,
+                                       DeferredRelease{p, &eraseFromHub});
+    } else {
+      return RefCountPolicy::decrement(counter);
+    }
+  }
+
+  friend void intrusive_ptr_release(const Derived *p) noexcept {
+    if (releaseReference(p)) {
+      Hub::erase(p);
+    }
+  }
+
+  // Release one reference to each object and hand every object whose last
+  // reference is gone to Hub::erase(std::span<Derived *>) in one go, so that
+  // the storage can free them batched (e.g. ConcurrentHive::eraseMany). The
+  // span is reused to collect those objects, its contents are unspecified
+  // afterwards.
+  friend void intrusive_ptr_release_many(std::span<Derived *> objects) {
+    std::size_t released = 0;
+
+    for (Derived *p : objects) {
+      if (releaseReference(p)) {
+        objects[released++] = p;
+      }
+    }
+
+    if (released != 0) {
+      Hub::erase(objects.first(released));
+    }
+  }
+};
+
+#endif // INTRUSIVE_RESOURCE_HPP_
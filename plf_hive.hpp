@@ -51,6 +51,14 @@
 #include <concepts>
 #include <compare> // std::strong_ordering
 #include <ranges>
+#include <bit> // std::has_single_bit, std::bit_ceil
+#include <cstdint> // std::uintptr_t
+
+#if defined(__AVX2__)
+	#include <immintrin.h> // live_slot_mask()
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h> // live_slot_mask()
+#endif
 
 
 
@@ -124,10 +132,71 @@ struct hive_limits // for use in block_capacity setting/getting functions and co
 
 
 
+// Opt-in constant-time element-to-group lookup, used by hive::erase_pointer(). Specialize for an element type and set block_alignment to a power of two to enable it.
+// Every group's element + skipfield memory block is then allocated as one block_alignment-sized allocation on a block_alignment boundary, with pointers to the owning group and hive stored in front of the first element, so both can be found by masking an element's address (see also hive::get_owner()).
+// The maximum block capacity is reduced so that a full group fits within one aligned block, and the default minimum block capacity becomes that maximum, as smaller groups would occupy a full aligned block anyway.
+template <class element_type>
+struct hive_block_traits
+{
+	static constexpr size_t block_alignment = 0;
+};
+
+
+
+// Block traits may additionally define slot_metadata_type (default-constructible, trivially destructible) to store an object of that type for every element slot, in an array of its own at the start of the aligned block. Meant for the few "hot" fields scanned over all elements (see hive::slot_metadata() and hive::for_each_slot_metadata()), which then stream through far fewer cache lines than the elements themselves.
+// An element's metadata is value-initialized right before the element is constructed, and stays in its slot: it is not moved along when sort(), reshape() or shrink_to_fit() relocate elements.
+template <class traits>
+struct hive_slot_metadata_of
+{
+	typedef void type;
+};
+
+template <class traits> requires requires { typename traits::slot_metadata_type; }
+struct hive_slot_metadata_of<traits>
+{
+	typedef typename traits::slot_metadata_type type;
+};
+
+
+
+// Block traits may also fix the skipfield type (uint_least8_t or uint_least16_t). By default, with aligned blocks it is the narrowest type able to index every element a full block can hold, as an 8-bit skipfield would cap a block of small elements at 255 of them and leave the rest of the aligned block unused. Without aligned blocks it is chosen from the element size as usual:
+template <class element_type, class traits>
+struct hive_skipfield_of
+{
+	static constexpr size_t block_alignment = traits::block_alignment;
+	static constexpr size_t slot_size = std::max({sizeof(element_type), alignof(element_type), static_cast<size_t>(2)});
+
+	typedef std::conditional_t<(block_alignment == 0) ? (sizeof(element_type) > 10 || alignof(element_type) > 10) : (block_alignment / slot_size > std::numeric_limits<uint_least8_t>::max()), uint_least16_t, uint_least8_t> type;
+};
+
+template <class element_type, class traits> requires requires { typename traits::skipfield_type; }
+struct hive_skipfield_of<element_type, traits>
+{
+	static_assert(std::is_same_v<typename traits::skipfield_type, uint_least8_t> || std::is_same_v<typename traits::skipfield_type, uint_least16_t>, "hive_block_traits::skipfield_type must be uint_least8_t or uint_least16_t");
+	typedef typename traits::skipfield_type type;
+};
+
+
+
+// Block traits may also set power_of_two_element_slots to pad every element slot to a power of two bytes. An element's slot index (see hive::slot_metadata()) is then a shift of its offset in the block rather than a division, and no element straddles more cache lines than it has to, at the cost of the padding:
+template <class traits>
+struct hive_power_of_two_slots_of
+{
+	static constexpr bool value = false;
+};
+
+template <class traits> requires requires { traits::power_of_two_element_slots; }
+struct hive_power_of_two_slots_of<traits>
+{
+	static constexpr bool value = traits::power_of_two_element_slots;
+};
+
+
+
 template <class element_type, class allocator_type = std::allocator<element_type> >
 class hive : private allocator_type // Empty base class optimisation - inheriting allocator functions
 {
-	typedef std::conditional_t<(sizeof(element_type) > 10 || alignof(element_type) > 10), uint_least16_t, uint_least8_t> skipfield_type;
+	typedef typename hive_skipfield_of<element_type, hive_block_traits<element_type> >::type skipfield_type;
 
 public:
 	// Standard container typedefs:
@@ -160,14 +229,15 @@ private:
 	// make the size of this struct the larger of alignof(T), sizeof(T) or 2*skipfield_type (the latter is only relevant for type char/uchar), and
 	// make the alignment alignof(T).
 	// This type is used mainly for correct pointer arithmetic while iterating over elements in memory.
+	static constexpr size_t element_slot_size_unpadded =
+		(sizeof(element_type) < (sizeof(skipfield_type) * 2)) ?
+		((sizeof(skipfield_type) * 2) < alignof(element_type) ? alignof(element_type) : (sizeof(skipfield_type) * 2)) :
+		((sizeof(element_type) < alignof(element_type)) ? alignof(element_type) : sizeof(element_type));
+
 	struct alignas(alignof(element_type)) aligned_element_struct
 	{
 		 // Using char as sizeof is always guaranteed to be 1 byte regardless of the number of bits in a byte on given computer, whereas for example, uint8_t would fail on machines where there are more than 8 bits in a byte eg. Texas Instruments C54x DSPs.
-		char data[
-		(sizeof(element_type) < (sizeof(skipfield_type) * 2)) ?
-		((sizeof(skipfield_type) * 2) < alignof(element_type) ? alignof(element_type) : (sizeof(skipfield_type) * 2)) :
-		((sizeof(element_type) < alignof(element_type)) ? alignof(element_type) : sizeof(element_type))
-		];
+		char data[hive_power_of_two_slots_of<hive_block_traits<element_type> >::value ? std::bit_ceil(element_slot_size_unpadded) : element_slot_size_unpadded];
 	};
 
 
@@ -220,6 +290,106 @@ private:
 	typedef typename std::allocator_traits<tuple_allocator_type>::pointer				tuple_pointer_type;
 
 
+	// Aligned-block support for O(1) element-to-group lookup, see hive_block_traits:
+	static constexpr size_t block_alignment = hive_block_traits<element_type>::block_alignment;
+	static_assert(block_alignment == 0 || (std::has_single_bit(block_alignment) && block_alignment >= alignof(element_type)), "hive_block_traits::block_alignment must be zero or a power of two no smaller than alignof(element_type)");
+
+	struct alignas((block_alignment == 0) ? alignof(element_type) : block_alignment) aligned_block_struct
+	{
+		char data[(block_alignment == 0) ? alignof(element_type) : block_alignment];
+	};
+
+	struct group_block_header
+	{
+		group_pointer_type group;
+		hive * owner; // Kept up to date when groups change hands through move, swap or splice
+	};
+
+	typedef typename std::allocator_traits<allocator_type>::template rebind_alloc<aligned_block_struct> 		aligned_block_allocator_type;
+	typedef typename std::allocator_traits<aligned_block_allocator_type>::pointer		aligned_block_pointer_type;
+
+public:
+	typedef typename hive_slot_metadata_of<hive_block_traits<element_type> >::type slot_metadata_type;
+
+private:
+	static constexpr bool has_slot_metadata = !std::is_void_v<slot_metadata_type>;
+	typedef std::conditional_t<has_slot_metadata, slot_metadata_type, char> slot_metadata_storage_type;
+	static_assert(!has_slot_metadata || block_alignment != 0, "hive_block_traits::slot_metadata_type requires block_alignment to be set");
+	static_assert(std::is_trivially_destructible<slot_metadata_storage_type>::value, "hive_block_traits::slot_metadata_type must be trivially destructible");
+
+	static constexpr size_t slot_metadata_size = has_slot_metadata ? sizeof(slot_metadata_storage_type) : 0;
+	static constexpr size_t slot_metadata_offset = ((sizeof(group_block_header) + alignof(slot_metadata_storage_type) - 1) / alignof(slot_metadata_storage_type)) * alignof(slot_metadata_storage_type);
+
+	// The first element is aligned to alignof(element_type), or with power_of_two_element_slots to the slot size, so that slots line up with cache lines as well:
+	static constexpr size_t first_element_alignment = hive_power_of_two_slots_of<hive_block_traits<element_type> >::value ? sizeof(aligned_element_struct) : alignof(element_type);
+
+	// Block space not proportional to capacity. With slot metadata the padding between the metadata array and the first element depends on the capacity, so the worst case is assumed:
+	static constexpr size_t block_fixed_size = has_slot_metadata ? slot_metadata_offset + first_element_alignment - 1 + sizeof(skipfield_type) : ((sizeof(group_block_header) + first_element_alignment - 1) / first_element_alignment) * first_element_alignment + sizeof(skipfield_type);
+
+	// The largest group which, together with its skipfield (including the extra trailing node), slot metadata and the block header, fits in one aligned block:
+	static constexpr size_t aligned_block_capacity_limit = (block_alignment <= block_fixed_size) ? 0 : std::min((block_alignment - block_fixed_size) / (sizeof(aligned_element_struct) + sizeof(skipfield_type) + slot_metadata_size), static_cast<size_t>(std::numeric_limits<skipfield_type>::max()));
+
+	// Everything in front of the first element, padded to first_element_alignment so that the first element stays correctly aligned: the block header, then the slot metadata array (sized for the largest group):
+	static constexpr size_t block_header_size = (block_alignment == 0) ? 0 : ((slot_metadata_offset + slot_metadata_size * aligned_block_capacity_limit + first_element_alignment - 1) / first_element_alignment) * first_element_alignment;
+
+
+	static aligned_pointer_type allocate_elements(aligned_struct_allocator_type &aligned_struct_allocator, const skipfield_type elements_per_group, const group_pointer_type previous)
+	{
+		if constexpr (block_alignment == 0)
+		{
+			return pointer_cast<aligned_pointer_type>(std::allocator_traits<aligned_struct_allocator_type>::allocate(aligned_struct_allocator, get_aligned_block_capacity(elements_per_group), (previous == nullptr) ? 0 : previous->elements));
+		}
+		else
+		{
+			static_assert(aligned_block_capacity_limit >= 3, "hive_block_traits::block_alignment is too small to hold the minimum block capacity");
+			assert(elements_per_group <= aligned_block_capacity_limit);
+			aligned_block_allocator_type block_allocator(aligned_struct_allocator);
+			char * const block = pointer_cast<char *>(std::allocator_traits<aligned_block_allocator_type>::allocate(block_allocator, 1));
+			return pointer_cast<aligned_pointer_type>(block + block_header_size);
+		}
+	}
+
+
+	static void deallocate_elements(aligned_struct_allocator_type &aligned_struct_allocator, const aligned_pointer_type elements, const skipfield_type elements_per_group) noexcept
+	{
+		if constexpr (block_alignment == 0)
+		{
+			std::allocator_traits<aligned_struct_allocator_type>::deallocate(aligned_struct_allocator, pointer_cast<aligned_struct_pointer_type>(elements), get_aligned_block_capacity(elements_per_group));
+		}
+		else
+		{
+			aligned_block_allocator_type block_allocator(aligned_struct_allocator);
+			std::allocator_traits<aligned_block_allocator_type>::deallocate(block_allocator, pointer_cast<aligned_block_pointer_type>(pointer_cast<char *>(elements) - block_header_size), 1);
+		}
+	}
+
+
+	// Any element pointer (including the group's one-past-end element pointer) masks down to the start of its aligned block, where the block header is stored:
+	static group_block_header * block_header_of(const aligned_pointer_type element_pointer) noexcept
+	{
+		static_assert(block_alignment != 0);
+		const std::uintptr_t block = reinterpret_cast<std::uintptr_t>(std::to_address(element_pointer)) & ~static_cast<std::uintptr_t>(block_alignment - 1);
+		return reinterpret_cast<group_block_header *>(block);
+	}
+
+
+	static group_pointer_type group_of(const aligned_pointer_type element_pointer) noexcept
+	{
+		return block_header_of(element_pointer)->group;
+	}
+
+
+
+	// Elements start at the same offset in every aligned block, so the slot index needs no group lookup:
+	static slot_metadata_storage_type * slot_metadata_of(const aligned_pointer_type element_pointer) noexcept
+	{
+		static_assert(has_slot_metadata);
+		char * const block = reinterpret_cast<char *>(block_header_of(element_pointer));
+		const size_t index = static_cast<size_t>(pointer_cast<char *>(element_pointer) - (block + block_header_size)) / sizeof(aligned_element_struct);
+		return reinterpret_cast<slot_metadata_storage_type *>(block + slot_metadata_offset) + index;
+	}
+
+
 	// group == element memory block + skipfield + block metadata
 	struct group
 	{
@@ -237,7 +407,7 @@ private:
 
 		group(aligned_struct_allocator_type &aligned_struct_allocator, const skipfield_type elements_per_group, group_pointer_type const previous):
 			next_group(nullptr),
-			elements(pointer_cast<aligned_pointer_type>(std::allocator_traits<aligned_struct_allocator_type>::allocate(aligned_struct_allocator, get_aligned_block_capacity(elements_per_group), (previous == nullptr) ? 0 : previous->elements))),
+			elements(allocate_elements(aligned_struct_allocator, elements_per_group, previous)),
 			previous_group(previous),
 			free_list_head(std::numeric_limits<skipfield_type>::max()),
 			capacity(elements_per_group),
@@ -248,6 +418,11 @@ private:
 		{
 			skipfield = pointer_cast<skipfield_pointer_type>(elements + elements_per_group);
 			std::memset(static_cast<void *>(std::to_address(skipfield)), 0, sizeof(skipfield_type) * (static_cast<size_type>(elements_per_group) + 1u));
+
+			if constexpr (block_alignment != 0)
+			{
+				::new (static_cast<void *>(pointer_cast<char *>(elements) - block_header_size)) group_block_header{std::pointer_traits<group_pointer_type>::pointer_to(*this), nullptr}; // owner is set by allocate_new_group()
+			}
 		}
 
 
@@ -286,6 +461,11 @@ private:
 	// Adaptive minimum based around aligned size, sizeof(group) and sizeof(hive):
 	static constexpr skipfield_type default_min_block_capacity() noexcept
 	{
+		if constexpr (block_alignment != 0)
+		{
+			return default_max_block_capacity(); // Every group occupies a full aligned block regardless of its capacity
+		}
+
 		constexpr skipfield_type adaptive_size = static_cast<skipfield_type>(((sizeof(hive) + sizeof(group)) * 2) / sizeof(aligned_element_struct));
 		constexpr skipfield_type max_block_capacity = default_max_block_capacity(); // Necessary to check against in situations with > 64bit pointer sizes and small sizeof(T)
 		return std::max(static_cast<skipfield_type>(8), std::min(adaptive_size, max_block_capacity));
@@ -296,7 +476,7 @@ private:
 	// Adaptive maximum based on numeric_limits and best outcome from multiple benchmark's (on balance) in terms of memory usage and performance:
 	static constexpr skipfield_type default_max_block_capacity() noexcept
 	{
-		return static_cast<skipfield_type>(std::min(static_cast<unsigned int>(std::numeric_limits<skipfield_type>::max()), 8192u));
+		return static_cast<skipfield_type>(std::min(static_cast<size_t>(block_capacity_hard_limits().max), static_cast<size_t>(8192u)));
 	}
 
 
@@ -443,6 +623,7 @@ public:
 	{
 		assert(&source != this);
 		source.blank();
+		reassign_block_owners();
 	}
 
 
@@ -464,6 +645,7 @@ public:
 	{
 		assert(&source != this);
 		source.blank();
+		reassign_block_owners();
 	}
 
 
@@ -709,6 +891,10 @@ private:
 			std::allocator_traits<group_allocator_type>::construct(group_allocator, new_group, aligned_struct_allocator, elements_per_group, previous);
 		#endif
 
+		if constexpr (block_alignment != 0)
+		{
+			block_header_of(new_group->elements)->owner = this;
+		}
 
 		return new_group;
 	}
@@ -717,12 +903,31 @@ private:
 
 	void deallocate_group(group_pointer_type const the_group) noexcept
 	{
-		std::allocator_traits<aligned_struct_allocator_type>::deallocate(aligned_struct_allocator, pointer_cast<aligned_struct_pointer_type>(the_group->elements), get_aligned_block_capacity(the_group->capacity));
+		deallocate_elements(aligned_struct_allocator, the_group->elements, the_group->capacity);
 		std::allocator_traits<group_allocator_type>::deallocate(group_allocator, the_group, 1);
 	}
 
 
 
+	// Point the block headers of all active and reserved groups at this hive, after groups have been taken over from another hive:
+	void reassign_block_owners() noexcept
+	{
+		if constexpr (block_alignment != 0)
+		{
+			for (group_pointer_type current_group = begin_iterator.group_pointer; current_group != nullptr; current_group = current_group->next_group)
+			{
+				block_header_of(current_group->elements)->owner = this;
+			}
+
+			for (group_pointer_type current_group = unused_groups_head; current_group != nullptr; current_group = current_group->next_group)
+			{
+				block_header_of(current_group->elements)->owner = this;
+			}
+		}
+	}
+
+
+
 	constexpr void destroy_element(const aligned_pointer_type element) noexcept
 	{
 		if constexpr (!std::is_trivially_destructible<element_type>::value) // to avoid codegen for trivial types
@@ -919,6 +1124,11 @@ private:
 	template<typename... arguments>
 	constexpr void construct_element(aligned_pointer_type const location, arguments &&... parameters)
 	{
+		if constexpr (has_slot_metadata)
+		{
+			::new (static_cast<void *>(slot_metadata_of(location))) slot_metadata_type();
+		}
+
 		std::allocator_traits<allocator_type>::construct(*this, pointer_cast<pointer>(location), std::forward<arguments>(parameters) ...);
 	}
 
@@ -1240,8 +1450,212 @@ public:
 
 
 
+	// Like emplace(), but steers insertions away from sparse groups (less than 1/sparse_group_divisor full) so that they drain and get deallocated once empty, instead of being kept alive by a few new elements each. emplace() reuses the erased locations of whichever group had its first erasure last, which after a large erasure is typically a sparse one. Here, if that group is sparse, the next few groups with erasures are checked for a denser one, then the unused space at the back of the hive is used. Only if neither exists is the sparse group reused, so this never allocates where emplace() wouldn't:
+	template<typename... arguments>
+	iterator emplace_dense(arguments &&... parameters)
+	{
+		if (erasure_groups_head != nullptr && is_sparse_group(erasure_groups_head))
+		{
+			group_pointer_type current_group = erasure_groups_head->erasures_list_next_group;
+
+			for (unsigned int checked = 0; current_group != nullptr && checked != dense_group_search_length && is_sparse_group(current_group); ++checked)
+			{
+				current_group = current_group->erasures_list_next_group;
+			}
+
+			if (current_group != nullptr && !is_sparse_group(current_group)) // Move it to the front of the list, which emplace() takes from
+			{
+				remove_from_groups_with_erasures_list(current_group);
+				current_group->erasures_list_next_group = erasure_groups_head;
+				erasure_groups_head->erasures_list_previous_group = current_group;
+				erasure_groups_head = current_group;
+			}
+			else if (end_iterator.element_pointer != pointer_cast<aligned_pointer_type>(end_iterator.group_pointer->skipfield)) // Back group has unused space, same as the first branch of emplace()
+			{
+				construct_element(end_iterator.element_pointer, std::forward<arguments>(parameters) ...);
+
+				const iterator return_iterator = end_iterator;
+				++end_iterator.element_pointer;
+				++end_iterator.skipfield_pointer;
+				++(end_iterator.group_pointer->size);
+				++total_size;
+
+				return return_iterator;
+			}
+		}
+
+		return emplace(std::forward<arguments>(parameters) ...);
+	}
+
+
+
+	// Constructs n elements from the same arguments into the unused space at the back of the hive, rather than into erased locations like emplace() does, so that they are adjacent in memory and iterated in order. Skipfields need no updating for that space. If the back group doesn't have room for all of them, a group with room for at least n elements (up to max_block_capacity) is started instead and the back group's remaining space is marked as erased, for later insertions to reuse. So the elements only span several groups when n > max_block_capacity. Returns an iterator to the first new element, the rest follow it:
+	template<typename... arguments>
+	iterator emplace_contiguous(size_type n, const arguments &... parameters)
+	{
+		if (n == 0) return end_iterator;
+
+		if (end_iterator.element_pointer == nullptr) // ie. empty hive, no blocks allocated yet
+		{
+			initialize(contiguous_group_capacity(n));
+			begin_iterator.group_pointer->size = 0; // the group constructor assumes one element is inserted
+		}
+
+		iterator first;
+
+		do
+		{
+			size_type space = static_cast<size_type>(pointer_cast<aligned_pointer_type>(end_iterator.group_pointer->skipfield) - end_iterator.element_pointer);
+
+			if (space < std::min(n, static_cast<size_type>(max_block_capacity)) && end_iterator.group_pointer->size != 0) // an empty back group is the only group, fill it instead
+			{
+				begin_contiguous_group(n, parameters...);
+
+				if (first.group_pointer == nullptr) first = iterator(end_iterator.group_pointer, end_iterator.group_pointer->elements, end_iterator.group_pointer->skipfield);
+				space = static_cast<size_type>(end_iterator.group_pointer->capacity) - 1u;
+				--n;
+			}
+			else if (first.group_pointer == nullptr)
+			{
+				first = end_iterator;
+			}
+
+			for (const aligned_pointer_type run_end = end_iterator.element_pointer + std::min(n, space); end_iterator.element_pointer != run_end;)
+			{
+				construct_element(end_iterator.element_pointer, parameters...);
+				++end_iterator.element_pointer;
+				++end_iterator.skipfield_pointer;
+				++(end_iterator.group_pointer->size);
+				++total_size;
+			}
+
+			n -= std::min(n, space);
+		} while (n != 0);
+
+		return first;
+	}
+
+
+
 private:
 
+	skipfield_type contiguous_group_capacity(const size_type n) const noexcept
+	{
+		return static_cast<skipfield_type>(std::clamp(std::max(n, total_size), static_cast<size_type>(min_block_capacity), static_cast<size_type>(max_block_capacity)));
+	}
+
+
+
+	// Start a new back group for emplace_contiguous(), reusing a reserved group if one is large enough, and construct its first element
+	template<typename... arguments>
+	void begin_contiguous_group(const size_type n, const arguments &... parameters)
+	{
+		const size_type needed_capacity = std::min(n, static_cast<size_type>(max_block_capacity));
+		group_pointer_type previous_unused_group = nullptr, next_group = unused_groups_head;
+
+		while (next_group != nullptr && next_group->capacity < needed_capacity)
+		{
+			previous_unused_group = next_group;
+			next_group = next_group->next_group;
+		}
+
+		if (next_group == nullptr)
+		{
+			const skipfield_type new_group_size = contiguous_group_capacity(n);
+			reset_group_numbers_if_necessary();
+			next_group = allocate_new_group(new_group_size, end_iterator.group_pointer);
+
+			#ifdef PLF_EXCEPTIONS_SUPPORT
+				if constexpr (!std::is_nothrow_constructible<element_type, const arguments &...>::value)
+				{
+					try
+					{
+						construct_element(next_group->elements, parameters...);
+					}
+					catch (...)
+					{
+						deallocate_group(next_group);
+						throw;
+					}
+				}
+				else
+			#endif
+			{
+				construct_element(next_group->elements, parameters...);
+			}
+
+			total_capacity += new_group_size;
+		}
+		else
+		{
+			construct_element(next_group->elements, parameters...);
+			((previous_unused_group == nullptr) ? unused_groups_head : previous_unused_group->next_group) = next_group->next_group;
+			reset_group_numbers_if_necessary();
+			next_group->reset(1, nullptr, end_iterator.group_pointer, end_iterator.group_pointer->group_number + 1u);
+		}
+
+		// Only now that nothing can throw anymore, so that the back group is left untouched on exception:
+		skip_back_group_unused_space();
+
+		end_iterator.group_pointer->next_group = next_group;
+		end_iterator.group_pointer = next_group;
+		end_iterator.element_pointer = next_group->elements + 1;
+		end_iterator.skipfield_pointer = next_group->skipfield + 1;
+		++total_size;
+	}
+
+
+
+	// Mark the unused element memory locations at the back of the back group as skipped/erased, as if they had been erased. Used when the back group stops being the back group while it still has unused space.
+	void skip_back_group_unused_space() noexcept
+	{
+		const skipfield_type distance_to_end = static_cast<skipfield_type>(pointer_cast<aligned_pointer_type>(end_iterator.group_pointer->skipfield) - end_iterator.element_pointer);
+
+		if (distance_to_end != 0) // 0 == edge case
+		{	 // Mark unused element memory locations from back group as skipped/erased:
+			// Update skipfield:
+			const skipfield_type previous_node_value = *(end_iterator.skipfield_pointer - 1);
+
+			if (previous_node_value == 0) // no previous skipblock
+			{
+				*end_iterator.skipfield_pointer = distance_to_end;
+				*(end_iterator.skipfield_pointer + distance_to_end - 1) = distance_to_end;
+
+				if (distance_to_end > 2) // make erased middle nodes non-zero for get_iterator
+				{
+					std::memset(static_cast<void *>(end_iterator.skipfield_pointer + 1), 1, sizeof(skipfield_type) * (distance_to_end - 2));
+				}
+
+				const skipfield_type index = static_cast<skipfield_type>(end_iterator.element_pointer - end_iterator.group_pointer->elements);
+
+				if (end_iterator.group_pointer->free_list_head != std::numeric_limits<skipfield_type>::max()) // ie. if this group already has some erased elements
+				{
+					edit_free_list_next(end_iterator.group_pointer->elements + end_iterator.group_pointer->free_list_head, index); // set prev free list head's 'next index' number to the index of the current element
+				}
+				else
+				{
+					end_iterator.group_pointer->erasures_list_next_group = erasure_groups_head; // add it to the groups-with-erasures free list
+					if (erasure_groups_head != nullptr) erasure_groups_head->erasures_list_previous_group = end_iterator.group_pointer;
+					erasure_groups_head = end_iterator.group_pointer;
+				}
+
+				edit_free_list_head(end_iterator.element_pointer, end_iterator.group_pointer->free_list_head);
+				end_iterator.group_pointer->free_list_head = index;
+			}
+			else
+			{ // update previous skipblock, no need to update free list:
+				*(end_iterator.skipfield_pointer - previous_node_value) = *(end_iterator.skipfield_pointer + distance_to_end - 1) = static_cast<skipfield_type>(previous_node_value + distance_to_end);
+
+				if (distance_to_end > 1) // make erased middle nodes non-zero for get_iterator
+				{
+					std::memset(static_cast<void *>(end_iterator.skipfield_pointer), 1, sizeof(skipfield_type) * (distance_to_end - 1));
+				}
+			}
+		}
+	}
+
+
+
 	// For catch blocks in fill() and range_fill()
 	void recover_from_partial_fill()
 	{
@@ -1786,6 +2200,98 @@ public:
 
 private:
 
+	static constexpr skipfield_type sparse_group_divisor = 4;
+	static constexpr unsigned int dense_group_search_length = 4; // Bounds the cost of emplace_dense() when most groups are sparse
+
+
+
+	static bool is_sparse_group(const group_pointer_type group_pointer) noexcept
+	{
+		return group_pointer->size < group_pointer->capacity / sparse_group_divisor;
+	}
+
+
+
+	// Bulk iteration (see group_range) looks at the skipfield live_mask_width slots at a time instead of following it one skipblock at a time, which in fragmented groups means a hard-to-predict branch per erased run. A skipfield node is zero if and only if its slot holds an element, whichever skipblock position an erased node is at, so a window's occupancy is one vector compare against zero:
+	static constexpr unsigned int live_mask_width = 64;
+
+	#if defined(__AVX2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+		static constexpr bool has_vector_live_slot_mask = true;
+	#else
+		static constexpr bool has_vector_live_slot_mask = false;
+	#endif
+
+	// Bit i is set if slot i of the window starting at skipfield holds an element. Only the first slot_count (at most live_mask_width) nodes are read:
+	static std::uint64_t live_slot_mask(const skipfield_pointer_type skipfield, const size_type slot_count) noexcept
+	{
+		const skipfield_type * const nodes = std::to_address(skipfield);
+
+		if (slot_count >= live_mask_width)
+		{
+			#if defined(__AVX2__)
+				const __m256i zero = _mm256_setzero_si256();
+				std::uint64_t mask = 0;
+
+				for (unsigned int offset = 0; offset != live_mask_width; offset += 32)
+				{
+					std::uint32_t live;
+
+					if constexpr (sizeof(skipfield_type) == 1)
+					{
+						live = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(nodes + offset)), zero)));
+					}
+					else
+					{
+						const __m256i low = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(nodes + offset)), zero);
+						const __m256i high = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(nodes + offset + 16)), zero);
+						// packs works within 128-bit lanes, the permute restores slot order:
+						live = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8)));
+					}
+
+					mask |= static_cast<std::uint64_t>(live) << offset;
+				}
+
+				return mask;
+			#elif defined(__ARM_NEON) && defined(__aarch64__)
+				// No movemask: weigh each byte lane's bit and add the lanes of each half up
+				static constexpr std::uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+				const uint8x16_t weight = vld1q_u8(weights);
+				std::uint64_t mask = 0;
+
+				for (unsigned int offset = 0; offset != live_mask_width; offset += 16)
+				{
+					uint8x16_t live;
+
+					if constexpr (sizeof(skipfield_type) == 1)
+					{
+						live = vceqzq_u8(vld1q_u8(nodes + offset));
+					}
+					else
+					{
+						live = vcombine_u8(vmovn_u16(vceqzq_u16(vld1q_u16(nodes + offset))), vmovn_u16(vceqzq_u16(vld1q_u16(nodes + offset + 8))));
+					}
+
+					const uint8x16_t bits = vandq_u8(live, weight);
+					mask |= (static_cast<std::uint64_t>(vaddv_u8(vget_low_u8(bits))) | (static_cast<std::uint64_t>(vaddv_u8(vget_high_u8(bits))) << 8)) << offset;
+				}
+
+				return mask;
+			#endif
+		}
+
+		std::uint64_t mask = 0;
+		const size_type count = (slot_count < live_mask_width) ? slot_count : live_mask_width;
+
+		for (size_type index = 0; index != count; ++index)
+		{
+			mask |= static_cast<std::uint64_t>(nodes[index] == 0) << index;
+		}
+
+		return mask;
+	}
+
+
+
 	void remove_from_groups_with_erasures_list(const group_pointer_type group_to_remove) noexcept
 	{
 		if (group_to_remove != erasure_groups_head)
@@ -2631,8 +3137,20 @@ public:
 
 
 
+	static constexpr hive_limits block_capacity_default_limits() noexcept
+	{
+		return default_block_capacity_limits();
+	}
+
+
+
 	static constexpr hive_limits block_capacity_hard_limits() noexcept
 	{
+		if constexpr (block_alignment != 0)
+		{
+			return hive_limits(3, aligned_block_capacity_limit);
+		}
+
 		return hive_limits(3, std::numeric_limits<skipfield_type>::max());
 	}
 
@@ -2734,6 +3252,7 @@ public:
 		}
 
 		source.blank();
+		reassign_block_owners();
 		return *this;
 	}
 
@@ -2989,6 +3508,272 @@ public:
 
 
 
+	// Return the hive owning the element pointed to by element_pointer, in O(1). Requires hive_block_traits<element_type>::block_alignment to be set:
+	static hive * get_owner(const const_pointer element_pointer) noexcept
+	{
+		return block_header_of(pointer_cast<aligned_pointer_type>(const_cast<pointer>(element_pointer)))->owner;
+	}
+
+
+
+	// Return the metadata stored for the slot of the element pointed to by element_pointer, in O(1). Requires hive_block_traits<element_type>::slot_metadata_type to be set:
+	static slot_metadata_storage_type & slot_metadata(const const_pointer element_pointer) noexcept requires has_slot_metadata
+	{
+		return *slot_metadata_of(pointer_cast<aligned_pointer_type>(const_cast<pointer>(element_pointer)));
+	}
+
+
+
+	// Call function(slot_metadata_type &, pointer) for every element of the hive, in iteration order. Only the skipfields and metadata arrays are read, not the elements themselves:
+	template <class function_type>
+	void for_each_slot_metadata(function_type &&function)
+	{
+		static_assert(has_slot_metadata, "for_each_slot_metadata() requires hive_block_traits<element_type>::slot_metadata_type to be set");
+
+		for_each_group_range([&function](const group_range &range)
+		{
+			range.for_each_slot_metadata(function);
+		});
+	}
+
+
+
+	// Calls function(size, capacity) for every active group in iteration order, i.e. how many of the group's element slots are occupied. Cheap, only the group headers are read. Unused groups retained for reuse (see trim_capacity()) are not visited, their total capacity is capacity() minus that of the visited groups:
+	template <class function_type>
+	void for_each_group_occupancy(function_type &&function) const
+	{
+		if (total_size == 0) return;
+
+		for (group_pointer_type current_group = begin_iterator.group_pointer;; current_group = current_group->next_group)
+		{
+			function(static_cast<size_type>(current_group->size), static_cast<size_type>(current_group->capacity));
+
+			if (current_group == end_iterator.group_pointer) break;
+		}
+	}
+
+
+
+	// The elements of one group together with its skipfield, see for_each_group_range(). Visiting a range only reads the memory of its own group, so the ranges of different groups can be visited concurrently, e.g. one per thread, as long as nothing is inserted into or erased from the hive meanwhile:
+	class group_range
+	{
+	public:
+		size_type size() const noexcept
+		{
+			return element_count;
+		}
+
+
+		// Calls function(element) for every element of the group, in iteration order. With AVX2 or NEON, occupied slots are found from a bitmask of live_mask_width skipfield nodes at a time (see live_slot_mask()) rather than by following the skipfield one erased run at a time:
+		template <class function_type>
+		void for_each(function_type &&function) const
+		{
+			for_each_index([&function, this](const size_type index)
+			{
+				function(*pointer_cast<pointer>(elements + index));
+			});
+		}
+
+
+		// Calls function(batch, count) with pointers to the group's elements in iteration order, up to live_mask_width of them at a time. For loops that want to prefetch, unroll or vectorize over elements themselves:
+		template <class function_type>
+		void for_each_batch(function_type &&function) const
+		{
+			pointer batch[live_mask_width];
+
+			for_each_window([&function, &batch, this](const size_type base, std::uint64_t mask)
+			{
+				size_type count = 0;
+
+				for (; mask != 0; mask &= mask - 1)
+				{
+					batch[count++] = pointer_cast<pointer>(elements + base + static_cast<size_type>(std::countr_zero(mask)));
+				}
+
+				function(static_cast<pointer const *>(batch), count);
+			});
+		}
+
+
+		// Same as hive::for_each_slot_metadata(), for the group's elements only:
+		template <class function_type>
+		void for_each_slot_metadata(function_type &&function) const
+		{
+			static_assert(has_slot_metadata, "for_each_slot_metadata() requires hive_block_traits<element_type>::slot_metadata_type to be set");
+
+			slot_metadata_storage_type * const metadata = slot_metadata_of(elements);
+
+			for_each_index([&function, metadata, this](const size_type index)
+			{
+				function(metadata[index], pointer_cast<pointer>(elements + index));
+			});
+		}
+
+	private:
+		friend class hive;
+
+
+		// Calls function(base, mask) for every window of live_mask_width slots, mask having bit i set if slot base + i is occupied. Windows without elements are skipped. A group without erasures doesn't need its skipfield read at all:
+		template <class function_type>
+		void for_each_window(function_type &&function) const
+		{
+			const bool dense = (element_count == end_index);
+
+			for (size_type base = 0; base < end_index; base += live_mask_width)
+			{
+				const size_type remaining = end_index - base;
+				std::uint64_t mask;
+
+				if (dense)
+				{
+					mask = (remaining >= live_mask_width) ? ~std::uint64_t{0} : (std::uint64_t{1} << remaining) - 1;
+				}
+				else
+				{
+					mask = live_slot_mask(skipfield + base, remaining);
+				}
+
+				if (mask != 0)
+				{
+					function(base, mask);
+				}
+			}
+		}
+
+
+		template <class function_type>
+		void for_each_index(function_type &&function) const
+		{
+			if constexpr (!has_vector_live_slot_mask)
+			{ // Building the masks node by node is slower than following the skipfield:
+				for (size_type index = *skipfield; index < end_index; ++index, index += skipfield[index])
+				{
+					function(index);
+				}
+			}
+			else
+			{
+				for_each_window([&function](const size_type base, std::uint64_t mask)
+				{
+					for (; mask != 0; mask &= mask - 1)
+					{
+						function(base + static_cast<size_type>(std::countr_zero(mask)));
+					}
+				});
+			}
+		}
+
+
+		group_range(const aligned_pointer_type elements_p, const skipfield_pointer_type skipfield_p, const size_type end_index_p, const size_type element_count_p) noexcept:
+			elements(elements_p),
+			skipfield(skipfield_p),
+			end_index(end_index_p),
+			element_count(element_count_p)
+		{}
+
+		aligned_pointer_type elements;
+		skipfield_pointer_type skipfield;
+		size_type end_index; // One past the last slot in use, the group's capacity unless it is the back group
+		size_type element_count;
+	};
+
+
+
+	// Calls function(group_range) for every active group in iteration order, splitting the hive at group boundaries so each group's elements can be handed to a different thread:
+	template <class function_type>
+	void for_each_group_range(function_type &&function)
+	{
+		if (total_size == 0) return;
+
+		for (group_pointer_type current_group = begin_iterator.group_pointer;; current_group = current_group->next_group)
+		{
+			const size_type end_index = (current_group == end_iterator.group_pointer) ? static_cast<size_type>(end_iterator.element_pointer - current_group->elements) : static_cast<size_type>(current_group->capacity);
+			function(group_range(current_group->elements, current_group->skipfield, end_index, static_cast<size_type>(current_group->size)));
+
+			if (current_group == end_iterator.group_pointer) break;
+		}
+	}
+
+
+
+	// Erase the element pointed to by element_pointer, which must point to a non-erased element of this hive.
+	// If hive_block_traits<element_type>::block_alignment is set, the owning group is found by masking the element's address which makes this O(1), otherwise this falls back to the O(number of groups) search done by get_iterator():
+	iterator erase_pointer(const const_pointer element_pointer)
+	{
+		if constexpr (block_alignment != 0)
+		{
+			const aligned_pointer_type aligned_element_pointer = pointer_cast<aligned_pointer_type>(const_cast<pointer>(element_pointer));
+			const group_pointer_type group_pointer = group_of(aligned_element_pointer);
+			return erase(const_iterator(group_pointer, aligned_element_pointer, group_pointer->skipfield + (aligned_element_pointer - group_pointer->elements)));
+		}
+		else
+		{
+			const const_iterator it = get_iterator(element_pointer);
+			assert(it != cend()); // ie. element_pointer does not point into this hive
+			return erase(it);
+		}
+	}
+
+
+
+	// Erase the elements pointed to by the range [first, last), which must point to distinct non-erased elements of this hive. Meant for releasing many elements at once, eg. when unloading a scene:
+	// The range is sorted by address (hence pointer_iterator must be random-access and its elements writable) so that the elements of each group are erased together and each group only has to be found once, rather than once per element.
+	// If all of a group's elements are erased they are destroyed without updating the skipfield or free list, which the group is about to be released with anyway. Otherwise each element's skipfield update is O(1), as in erase().
+	template <class pointer_iterator>
+	void erase_pointers(const pointer_iterator first, const pointer_iterator last)
+	{
+		std::sort(first, last, std::less<const_pointer>());
+
+		for (pointer_iterator run_begin = first; run_begin != last;)
+		{
+			group_pointer_type group_pointer;
+
+			if constexpr (block_alignment != 0)
+			{
+				group_pointer = group_of(pointer_cast<aligned_pointer_type>(const_cast<pointer>(static_cast<const_pointer>(*run_begin))));
+			}
+			else
+			{
+				const const_iterator it = get_iterator(*run_begin);
+				assert(it != cend()); // ie. element_pointer does not point into this hive
+				group_pointer = it.group_pointer;
+			}
+
+			const const_pointer group_end = pointer_cast<pointer>(pointer_cast<aligned_pointer_type>(group_pointer->skipfield));
+			pointer_iterator run_end = run_begin;
+
+			do
+			{
+				++run_end;
+			} while (run_end != last && std::less<const_pointer>()(*run_end, group_end));
+
+			const size_type run_size = static_cast<size_type>(run_end - run_begin);
+
+			if (run_size == group_pointer->size) // Every element in the group is erased: destroy all but the last one, whose erase() then releases the group
+			{
+				if constexpr (!std::is_trivially_destructible<element_type>::value)
+				{
+					for (pointer_iterator current = run_begin; current != run_end - 1; ++current)
+					{
+						destroy_element(pointer_cast<aligned_pointer_type>(const_cast<pointer>(static_cast<const_pointer>(*current))));
+					}
+				}
+
+				total_size -= run_size - 1;
+				group_pointer->size = 1;
+				run_begin = run_end - 1;
+			}
+
+			for (; run_begin != run_end; ++run_begin)
+			{
+				const aligned_pointer_type element_pointer = pointer_cast<aligned_pointer_type>(const_cast<pointer>(static_cast<const_pointer>(*run_begin)));
+				erase(const_iterator(group_pointer, element_pointer, group_pointer->skipfield + (element_pointer - group_pointer->elements)));
+			}
+		}
+	}
+
+
+
 	allocator_type get_allocator() const noexcept
 	{
 		return static_cast<allocator_type>(*this);
@@ -3074,49 +3859,7 @@ public:
 			}
 
 
-			const skipfield_type distance_to_end = static_cast<skipfield_type>(pointer_cast<aligned_pointer_type>(end_iterator.group_pointer->skipfield) - end_iterator.element_pointer);
-
-			if (distance_to_end != 0) // 0 == edge case
-			{	 // Mark unused element memory locations from back group as skipped/erased:
-				// Update skipfield:
-				const skipfield_type previous_node_value = *(end_iterator.skipfield_pointer - 1);
-
-				if (previous_node_value == 0) // no previous skipblock
-				{
-					*end_iterator.skipfield_pointer = distance_to_end;
-					*(end_iterator.skipfield_pointer + distance_to_end - 1) = distance_to_end;
-
-					if (distance_to_end > 2) // make erased middle nodes non-zero for get_iterator
-					{
-						std::memset(static_cast<void *>(end_iterator.skipfield_pointer + 1), 1, sizeof(skipfield_type) * (distance_to_end - 2));
-					}
-
-					const skipfield_type index = static_cast<skipfield_type>(end_iterator.element_pointer - end_iterator.group_pointer->elements);
-
-					if (end_iterator.group_pointer->free_list_head != std::numeric_limits<skipfield_type>::max()) // ie. if this group already has some erased elements
-					{
-						edit_free_list_next(end_iterator.group_pointer->elements + end_iterator.group_pointer->free_list_head, index); // set prev free list head's 'next index' number to the index of the current element
-					}
-					else
-					{
-						end_iterator.group_pointer->erasures_list_next_group = erasure_groups_head; // add it to the groups-with-erasures free list
-						if (erasure_groups_head != nullptr) erasure_groups_head->erasures_list_previous_group = end_iterator.group_pointer;
-						erasure_groups_head = end_iterator.group_pointer;
-					}
-
-					edit_free_list_head(end_iterator.element_pointer, end_iterator.group_pointer->free_list_head);
-					end_iterator.group_pointer->free_list_head = index;
-				}
-				else
-				{ // update previous skipblock, no need to update free list:
-					*(end_iterator.skipfield_pointer - previous_node_value) = *(end_iterator.skipfield_pointer + distance_to_end - 1) = static_cast<skipfield_type>(previous_node_value + distance_to_end);
-
-					if (distance_to_end > 1) // make erased middle nodes non-zero for get_iterator
-					{
-						std::memset(static_cast<void *>(end_iterator.skipfield_pointer), 1, sizeof(skipfield_type) * (distance_to_end - 1));
-					}
-				}
-			}
+			skip_back_group_unused_space();
 
 
 			// Join the destination and source group chains:
@@ -3192,6 +3935,9 @@ public:
 			source.end_iterator = source.begin_iterator;
 			original_unused_groups_head->reset(0, nullptr, nullptr, 0);
 		}
+
+		reassign_block_owners();
+		source.reassign_block_owners();
 	}
 
 
@@ -3479,6 +4225,9 @@ public:
 				source.tuple_allocator = tuple_allocator_type(source);
 			} // else: undefined behaviour, as per standard
 		}
+
+		reassign_block_owners();
+		source.reassign_block_owners();
 	}
 
 
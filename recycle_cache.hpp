@@ -0,0 +1,158 @@
+#ifndef RECYCLE_CACHE_HPP_
+#define RECYCLE_CACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/// Keeps released objects alive for reuse by a later creation with the same
+/// Key, e.g. render targets of one descriptor recreated every frame, which
+/// saves destroying and recreating both the CPU object and its GPU memory.
+///
+/// An object is only handed out again once the GPU finished the last
+/// submission using it (retireAfter <= completed submission index). The
+/// cached objects' bytes are kept within a budget by evicting the least
+/// recently cached ones. The cache only indexes objects living elsewhere,
+/// what freeing an evicted one means is up to the caller.
+///
+/// Thread-safe, guarded by one mutex.
+template <typename Key, typename T, typename Hash = std::hash<Key>>
+class RecycleCache {
+public:
+  struct Stats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t evictions = 0;
+    std::size_t count = 0;
+    std::size_t bytes = 0;
+  };
+
+  // A budget of 0 disables the cache
+  explicit RecycleCache(std::size_t budget) noexcept : mBudget{budget} {}
+
+#pragma region noncopyable
+  RecycleCache(const RecycleCache &) = delete;
+  RecycleCache &operator=(const RecycleCache &) = delete;
+  RecycleCache(RecycleCache &&) = delete;
+  RecycleCache &operator=(RecycleCache &&) = delete;
+#pragma endregion noncopyable
+
+  bool enabled() const noexcept { return mBudget != 0; }
+
+  // Cache object, which take(key) may return once submission retireAfter has
+  // completed. Calls evict(T *) for every object dropped to stay within the
+  // budget (object itself if it alone is larger), after unlocking, so evict
+  // may free it right away.
+  template <typename Evict>
+  void insert(const Key &key, T *object, std::uint64_t retireAfter,
+              std::size_t bytes, Evict &&evict) {
+    if (bytes > mBudget) {
+      evict(object);
+      return;
+    }
+
+    std::vector<T *> evicted;
+    {
+      std::lock_guard lock{mMutex};
+
+      while (mBytes + bytes > mBudget) {
+        evicted.push_back(mLru.back().object);
+        removeLocked(std::prev(mLru.end()));
+        ++mEvictions;
+      }
+
+      mLru.push_front(Entry{key, object, retireAfter, bytes});
+      mByKey.emplace(key, mLru.begin());
+      mBytes += bytes;
+    }
+
+    for (T *evictedObject : evicted) {
+      evict(evictedObject);
+    }
+  }
+
+  // A cached object for key whose last submission has completed, or nullptr
+  T *take(const Key &key, std::uint64_t completedSubmissionIndex) {
+    std::lock_guard lock{mMutex};
+
+    const auto [begin, end] = mByKey.equal_range(key);
+    for (auto it = begin; it != end; ++it) {
+      if (it->second->retireAfter <= completedSubmissionIndex) {
+        T *object = it->second->object;
+        removeLocked(it->second);
+        ++mHits;
+
+        return object;
+      }
+    }
+
+    ++mMisses;
+    return nullptr;
+  }
+
+  // Drop every cached object, calling evict(T *) for each after unlocking
+  template <typename Evict> void clear(Evict &&evict) {
+    std::vector<T *> evicted;
+    {
+      std::lock_guard lock{mMutex};
+      for (const Entry &entry : mLru) {
+        evicted.push_back(entry.object);
+      }
+
+      mEvictions += evicted.size();
+      mLru.clear();
+      mByKey.clear();
+      mBytes = 0;
+    }
+
+    for (T *object : evicted) {
+      evict(object);
+    }
+  }
+
+  Stats stats() const {
+    std::lock_guard lock{mMutex};
+    return {mHits, mMisses, mEvictions, mLru.size(), mBytes};
+  }
+
+private:
+  struct Entry {
+    Key key;
+    T *object;
+    std::uint64_t retireAfter;
+    std::size_t bytes;
+  };
+
+  using LruIterator = typename std::list<Entry>::iterator;
+
+  void removeLocked(LruIterator entry) {
+    const auto [begin, end] = mByKey.equal_range(entry->key);
+    for (auto it = begin; it != end; ++it) {
+      if (it->second == entry) {
+        mByKey.erase(it);
+        break;
+      }
+    }
+
+    mBytes -= entry->bytes;
+    mLru.erase(entry);
+  }
+
+  const std::size_t mBudget;
+
+  mutable std::mutex mMutex;
+  // Most recently cached first
+  std::list<Entry> mLru;
+  std::unordered_multimap<Key, LruIterator, Hash> mByKey;
+  std::size_t mBytes = 0;
+  std::uint64_t mHits = 0;
+  std::uint64_t mMisses = 0;
+  std::uint64_t mEvictions = 0;
+};
+
+#endif // RECYCLE_CACHE_HPP_
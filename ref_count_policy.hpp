@@ -0,0 +1,93 @@
+#ifndef REF_COUNT_POLICY_HPP_
+#define REF_COUNT_POLICY_HPP_
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+
+/// Reference counting policies for IntrusiveResource. A policy provides
+/// - counter_type, the per-object counter, value-initialized to zero
+/// - increment(counter)
+/// - decrement(counter), returning true when the last reference is gone
+/// - load(counter), the current count for diagnostics
+/// All of them are static so that add_ref/release inline completely.
+///
+/// A policy that may only learn later, possibly on another thread, that the
+/// last reference is gone (see BiasedRefCount) provides
+/// decrement(counter, DeferredRelease) instead and calls the DeferredRelease
+/// itself once it does.
+
+// How to release the storage of an object whose count dropped to zero.
+struct DeferredRelease {
+  const void *object;
+  void (*erase)(const void *object);
+
+  void operator()() const { erase(object); }
+};
+
+// Thread-safe counter with the same orderings boost::intrusive_ref_counter uses
+// with thread_safe_counter:
+// - taking a reference can be relaxed, the caller already holds one so the
+//   object can't go away and nothing is published by the increment
+// - dropping a reference releases, so every write made through it happens
+//   before the object is destroyed, and only the thread seeing the count drop
+//   to zero pays for the acquire fence it needs to observe all those writes
+// With the default seq_cst both would be full barriers on ARM.
+struct AtomicRefCount {
+  using counter_type = std::atomic<std::uint64_t>;
+
+  static void increment(counter_type &counter) noexcept {
+    counter.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static bool decrement(counter_type &counter) noexcept {
+    if (counter.fetch_sub(1, std::memory_order_release) == 1) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return true;
+    }
+
+    return false;
+  }
+
+  static std::uint64_t load(const counter_type &counter) noexcept {
+    return counter.load(std::memory_order_relaxed);
+  }
+};
+
+// Plain integer counter for resources that never leave the thread that
+// created them, like command encoders and per-pass bind groups, the same thing
+// boost::intrusive_ref_counter does with thread_unsafe_counter. Debug builds
+// remember the thread taking the first reference and assert that every later
+// AddRef/Release happens on it.
+struct ThreadUnsafeRefCount {
+  struct counter_type {
+    std::uint64_t value;
+#ifndef NDEBUG
+    std::thread::id owner;
+#endif
+  };
+
+  static void increment(counter_type &counter) noexcept {
+#ifndef NDEBUG
+    if (counter.value == 0) {
+      counter.owner = std::this_thread::get_id();
+    }
+    assert(counter.owner == std::this_thread::get_id() &&
+           "single-threaded resource referenced from another thread");
+#endif
+    ++counter.value;
+  }
+
+  static bool decrement(counter_type &counter) noexcept {
+    assert(counter.owner == std::this_thread::get_id() &&
+           "single-threaded resource released from another thread");
+    return --counter.value == 0;
+  }
+
+  static std::uint64_t load(const counter_type &counter) noexcept {
+    return counter.value;
+  }
+};
+
+#endif // REF_COUNT_POLICY_HPP_
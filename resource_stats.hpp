@@ -0,0 +1,205 @@
+#ifndef RESOURCE_STATS_HPP_
+#define RESOURCE_STATS_HPP_
+
+#include "concurrent_hive.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 0 compiles out every counter update, the default in release (NDEBUG)
+// builds. Snapshots then only hold what the hives know themselves: live
+// count, peak, capacity and block occupancy. Define to 1 to keep the counters
+// in a release build that exports metrics.
+#ifndef WEBGPU_RESOURCE_STATS
+#ifdef NDEBUG
+#define WEBGPU_RESOURCE_STATS 0
+#else
+#define WEBGPU_RESOURCE_STATS 1
+#endif
+#endif
+
+/// Durations in power of two buckets: bucket i counts [2^i, 2^(i+1)) ns,
+/// bucket 0 also counts 0 and the last one everything longer (~9 minutes).
+struct LatencyHistogram {
+  static constexpr std::size_t kBucketCount = 40;
+
+  static std::size_t bucketOf(std::chrono::nanoseconds duration) noexcept {
+    const auto ns = static_cast<std::uint64_t>(
+        std::max<std::chrono::nanoseconds::rep>(duration.count(), 0));
+
+    // | 1 puts 0 into bucket 0 as well
+    const auto width = static_cast<std::size_t>(std::bit_width(ns | 1));
+
+    return std::min(width - 1, kBucketCount - 1);
+  }
+
+  std::uint64_t total() const noexcept {
+    std::uint64_t total = 0;
+    for (std::uint64_t count : counts) {
+      total += count;
+    }
+
+    return total;
+  }
+
+  // Upper end of the bucket percentile (0 to 100) falls into, so at most
+  // twice the real value. Zero if nothing was recorded.
+  std::chrono::nanoseconds percentile(double percentile) const noexcept {
+    const std::uint64_t total = this->total();
+    if (total == 0) {
+      return {};
+    }
+
+    const auto rank = static_cast<std::uint64_t>(percentile / 100 * total);
+    std::uint64_t seen = 0;
+    std::size_t bucket = 0;
+
+    for (; bucket + 1 < kBucketCount; ++bucket) {
+      seen += counts[bucket];
+      if (seen > rank) {
+        break;
+      }
+    }
+
+    return std::chrono::nanoseconds{std::uint64_t{2} << bucket};
+  }
+
+  std::array<std::uint64_t, kBucketCount> counts{};
+};
+
+namespace resource_stats_detail {
+constexpr std::size_t kSlotCount = 32;
+
+// Threads past kSlotCount share slots, numbered like ConcurrentHive shards
+inline std::size_t slotIndex() noexcept {
+  return concurrent_hive_detail::threadIndex() % kSlotCount;
+}
+} // namespace resource_stats_detail
+
+/// Creations and releases of one resource type of one device. Every thread
+/// counts in a cache line of its own, so counting is an uncontended relaxed
+/// atomic add, and totals() sums them up when they are read.
+class ResourceCounters {
+public:
+  struct Totals {
+    std::uint64_t created = 0;
+    std::uint64_t released = 0;
+  };
+
+  void onCreated(std::uint64_t count = 1) noexcept {
+    slot().created.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  void onReleased(std::uint64_t count = 1) noexcept {
+    slot().released.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  // The slots are read one after the other while other threads keep
+  // counting, so this is not from one exact moment
+  Totals totals() const noexcept {
+    Totals totals;
+    for (const Slot &slot : mSlots) {
+      totals.created += slot.created.load(std::memory_order_relaxed);
+      totals.released += slot.released.load(std::memory_order_relaxed);
+    }
+
+    return totals;
+  }
+
+private:
+  struct alignas(64) Slot {
+    std::atomic<std::uint64_t> created{0};
+    std::atomic<std::uint64_t> released{0};
+  };
+
+  Slot &slot() noexcept { return mSlots[resource_stats_detail::slotIndex()]; }
+
+  std::array<Slot, resource_stats_detail::kSlotCount> mSlots;
+};
+
+/// LatencyHistogram recorded from any thread, with per-thread buckets like
+/// ResourceCounters.
+class LatencyCounters {
+public:
+  void record(std::chrono::nanoseconds duration) noexcept {
+    mSlots[resource_stats_detail::slotIndex()]
+        .counts[LatencyHistogram::bucketOf(duration)]
+        .fetch_add(1, std::memory_order_relaxed);
+  }
+
+  LatencyHistogram histogram() const noexcept {
+    LatencyHistogram histogram;
+    for (const Slot &slot : mSlots) {
+      for (std::size_t i = 0; i < LatencyHistogram::kBucketCount; ++i) {
+        histogram.counts[i] += slot.counts[i].load(std::memory_order_relaxed);
+      }
+    }
+
+    return histogram;
+  }
+
+private:
+  struct alignas(64) Slot {
+    std::array<std::atomic<std::uint64_t>, LatencyHistogram::kBucketCount>
+        counts{};
+  };
+
+  std::array<Slot, resource_stats_detail::kSlotCount> mSlots;
+};
+
+/// Everything known about the resources of one type at the time of a
+/// snapshot, see Resources::snapshotStats.
+struct ResourceTypeStats {
+  // Blocks are counted in kOccupancyBucketCount buckets by how full they are
+  static constexpr std::size_t kOccupancyBucketCount = 8;
+
+  std::string_view type;
+  // Since the device was created, while stats were enabled
+  std::uint64_t created = 0;
+  std::uint64_t released = 0;
+  // Since the previous snapshot, 0 in the first one
+  double createdPerSecond = 0;
+  double releasedPerSecond = 0;
+  std::size_t live = 0;
+  // Sum of each hive shard's peak, so the peak of live if every thread
+  // created in a shard of its own and an upper bound of it otherwise
+  std::size_t peak = 0;
+  // Element slots of all allocated blocks, used, erased and unused
+  std::size_t capacity = 0;
+  // Blocks holding elements. Bucket i counts those with between
+  // i / kOccupancyBucketCount and (i + 1) / kOccupancyBucketCount of their
+  // slots in use, the last one includes full blocks. Many blocks in the
+  // lower buckets is fragmentation trimming can't give back.
+  std::size_t blockCount = 0;
+  std::array<std::size_t, kOccupancyBucketCount> blockOccupancy{};
+
+  // Fill in everything the hive knows
+  template <typename Hive> void collectFrom(const Hive &hive) {
+    const auto occupancy = hive.occupancy();
+    live = occupancy.size;
+    capacity = occupancy.capacity;
+
+    peak = 0;
+    for (std::size_t shardPeak : hive.peakShardSizes()) {
+      peak += shardPeak;
+    }
+
+    blockCount = 0;
+    blockOccupancy = {};
+    hive.forEachBlockOccupancy(
+        [this](std::size_t blockSize, std::size_t blockCapacity) {
+          ++blockCount;
+          ++blockOccupancy[std::min(
+              blockSize * kOccupancyBucketCount / blockCapacity,
+              kOccupancyBucketCount - 1)];
+        });
+  }
+};
+
+#endif // RESOURCE_STATS_HPP_
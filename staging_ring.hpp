@@ -0,0 +1,154 @@
+#ifndef STAGING_RING_HPP_
+#define STAGING_RING_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <new>
+
+/// Part of a StagingRing the caller writes upload data to directly, and a
+/// copy command reads from with the submission it was allocated for. Empty
+/// (data == nullptr) if it didn't fit.
+struct StagingSlice {
+  std::byte *data = nullptr;
+  // Into the staging VkBuffer, for vkCmdCopyBufferToImage / ToBuffer
+  std::uint64_t offset = 0;
+  std::uint64_t size = 0;
+
+  explicit operator bool() const noexcept { return data != nullptr; }
+};
+
+/// One persistently mapped, host visible staging buffer used as a ring for
+/// all uploads to textures and buffers of a device, instead of creating,
+/// mapping and destroying a staging buffer for each.
+///
+/// Slices are allocated at the head, tagged with the submission whose copy
+/// commands read them. retire() moves the tail past every slice whose
+/// submission the GPU has finished, so memory is reused in submission
+/// order without tracking slices one by one. A slice never wraps: one that
+/// doesn't fit before the end starts over at the beginning.
+///
+/// The buffer is allocated on first use. Thread-safe, guarded by one mutex.
+class StagingRing {
+public:
+  // Stand-in for VkPhysicalDeviceLimits::optimalBufferCopyOffsetAlignment
+  // and nonCoherentAtomSize
+  static constexpr std::uint64_t kDefaultAlignment = 256;
+
+  struct Stats {
+    std::uint64_t capacity = 0;
+    // Held by submissions the GPU hasn't finished, or not yet submitted
+    std::uint64_t usedBytes = 0;
+    // Allocations that didn't fit
+    std::uint64_t failed = 0;
+  };
+
+  // Rounded up to kDefaultAlignment, so that offsets modulo the capacity stay
+  // aligned
+  explicit StagingRing(std::uint64_t capacity) noexcept
+      : mCapacity{(capacity + kDefaultAlignment - 1) &
+                  ~(kDefaultAlignment - 1)} {
+    assert(mCapacity != 0);
+  }
+
+#pragma region noncopyable
+  StagingRing(const StagingRing &) = delete;
+  StagingRing &operator=(const StagingRing &) = delete;
+  StagingRing(StagingRing &&) = delete;
+  StagingRing &operator=(StagingRing &&) = delete;
+#pragma endregion noncopyable
+
+  // size bytes the GPU reads with submission submissionIndex, usually
+  // Queue::getPendingSubmissionIndex. Empty if more than is free right now
+  // or than the ring holds at all: submit and retire, or split the upload.
+  StagingSlice allocate(std::uint64_t size, std::uint64_t submissionIndex,
+                        std::uint64_t alignment = kDefaultAlignment) {
+    assert(alignment != 0 && (alignment & (alignment - 1)) == 0 &&
+           alignment <= kDefaultAlignment);
+
+    std::lock_guard lock{mMutex};
+
+    if (size == 0 || size > mCapacity) {
+      ++mFailed;
+      return {};
+    }
+
+    if (!mMemory) {
+      // vkCreateBuffer, vkAllocateMemory and vkMapMemory, kept mapped until
+      // the device is destroyed
+      mMemory.reset(static_cast<std::byte *>(::operator new(
+          mCapacity, std::align_val_t{kDefaultAlignment})));
+    }
+
+    // Positions count bytes ever allocated, the offset is position modulo
+    // capacity
+    std::uint64_t position = (mHead + alignment - 1) & ~(alignment - 1);
+    if (position % mCapacity + size > mCapacity) {
+      position = (position / mCapacity + 1) * mCapacity;
+    }
+
+    if (position + size - mTail > mCapacity) {
+      ++mFailed;
+      return {};
+    }
+
+    mHead = position + size;
+
+    // Slices must retire in order, so one allocated for a submission older
+    // than the latest one (read before another thread submitted) waits for
+    // the latest as well
+    if (!mFences.empty() &&
+        mFences.back().submissionIndex >= submissionIndex) {
+      mFences.back().end = mHead;
+    } else {
+      mFences.push_back({submissionIndex, mHead});
+    }
+
+    const std::uint64_t offset = position % mCapacity;
+    return {mMemory.get() + offset, offset, size};
+  }
+
+  // Reuse the slices of every submission <= completedSubmissionIndex
+  void retire(std::uint64_t completedSubmissionIndex) noexcept {
+    std::lock_guard lock{mMutex};
+
+    while (!mFences.empty() &&
+           mFences.front().submissionIndex <= completedSubmissionIndex) {
+      mTail = mFences.front().end;
+      mFences.pop_front();
+    }
+  }
+
+  Stats stats() const {
+    std::lock_guard lock{mMutex};
+    return {mCapacity, mHead - mTail, mFailed};
+  }
+
+private:
+  // Everything before end belongs to submissionIndex or an older one
+  struct Fence {
+    std::uint64_t submissionIndex;
+    std::uint64_t end;
+  };
+
+  struct Unmap {
+    void operator()(std::byte *memory) const noexcept {
+      ::operator delete(memory, std::align_val_t{kDefaultAlignment});
+    }
+  };
+
+  const std::uint64_t mCapacity;
+
+  mutable std::mutex mMutex;
+  std::unique_ptr<std::byte, Unmap> mMemory;
+  std::uint64_t mHead = 0;
+  std::uint64_t mTail = 0;
+  std::deque<Fence> mFences;
+  std::uint64_t mFailed = 0;
+};
+
+#endif // STAGING_RING_HPP_
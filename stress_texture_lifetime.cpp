@@ -0,0 +1,321 @@
+// Millions of resources are created, the per-resource trace would dominate
+#define WEBGPU_RESOURCES_TRACE 0
+#define CONCURRENT_HIVE_LOCK_STATS 1
+
+#include "webgpu_resources.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <print>
+#include <random>
+#include <span>
+#include <thread>
+#include <vector>
+
+/// Hammers the texture C API (wgpuInstanceRequestTexture, wgpuTextureAddRef,
+/// wgpuTextureRelease, wgpuTextureDestroy) from N threads with the sharing
+/// patterns a renderer produces, and reports how throughput scales with the
+/// thread count and how often the Texture hive's shard locks were contended.
+///
+/// - private: every thread creates, references and releases its own
+///   textures, like per-frame transient resources. Creation and erasure stay
+///   in the thread's own shard.
+/// - shared: all threads AddRef/Release the same set of long-lived textures
+///   (atlases, shadow maps...), so their counters bounce between cores.
+/// - handoff: textures are created on one thread and dropped on another, like
+///   a loader thread feeding the render thread, so erasure goes to a shard
+///   another thread creates in.
+/// - sampler: shared default samplers, exercising BiasedRefCount.
+///
+/// Meanwhile one thread submits frames, which frees destroyed textures and
+/// runs the TrimScheduler concurrently with everything else.
+///
+/// Build it with -fsanitize=thread to check the paths for races, with a short
+/// duration since TSan slows everything down:
+///   stress_texture_lifetime [milliseconds per run, default 200] [max threads]
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Each pattern is set up on a fresh device, then step() runs on every thread
+// until the time is up. step() returns the number of C API calls it made.
+class PrivatePattern {
+public:
+  static constexpr const char *kName = "private";
+
+  explicit PrivatePattern(Device &device) : mDevice{device} {}
+
+  std::uint64_t step(std::minstd_rand &random) {
+    Texture *texture = wgpuInstanceRequestTexture(&mDevice);
+    wgpuTextureAddRef(texture);
+    wgpuTextureRelease(texture);
+
+    // Some are destroyed explicitly before their last release
+    if (random() % 4 == 0) {
+      wgpuTextureDestroy(texture);
+      wgpuTextureRelease(texture);
+      return 5;
+    }
+
+    wgpuTextureRelease(texture);
+    return 4;
+  }
+
+private:
+  Device &mDevice;
+};
+
+class SharedPattern {
+public:
+  static constexpr const char *kName = "shared";
+
+  explicit SharedPattern(Device &device) {
+    for (Texture *&texture : mTextures) {
+      texture = wgpuInstanceRequestTexture(&device);
+    }
+  }
+
+  ~SharedPattern() {
+    for (Texture *texture : mTextures) {
+      wgpuTextureRelease(texture);
+    }
+  }
+
+  // Hold a few references at once, as a recorded command buffer would
+  std::uint64_t step(std::minstd_rand &random) {
+    std::array<Texture *, 8> used;
+    for (Texture *&texture : used) {
+      texture = mTextures[random() % mTextures.size()];
+      wgpuTextureAddRef(texture);
+    }
+
+    for (Texture *texture : used) {
+      wgpuTextureRelease(texture);
+    }
+
+    return 2 * used.size();
+  }
+
+private:
+  // Few enough that threads keep hitting the same ones
+  std::array<Texture *, 64> mTextures;
+};
+
+class HandoffPattern {
+public:
+  static constexpr const char *kName = "handoff";
+
+  explicit HandoffPattern(Device &device) : mDevice{device} {}
+
+  ~HandoffPattern() {
+    for (std::atomic<Texture *> &slot : mSlots) {
+      if (Texture *texture = slot.load()) {
+        wgpuTextureRelease(texture);
+      }
+    }
+  }
+
+  // Publish a new texture and take ownership of whichever one it replaced,
+  // most likely created by another thread
+  std::uint64_t step(std::minstd_rand &random) {
+    Texture *texture = wgpuInstanceRequestTexture(&mDevice);
+    Texture *replaced = mSlots[random() % mSlots.size()].exchange(
+        texture, std::memory_order_acq_rel);
+
+    if (replaced == nullptr) {
+      return 1;
+    }
+
+    wgpuTextureAddRef(replaced);
+    wgpuTextureDestroy(replaced);
+    wgpuTextureRelease(replaced);
+    wgpuTextureRelease(replaced);
+    return 5;
+  }
+
+private:
+  Device &mDevice;
+  std::array<std::atomic<Texture *>, 4096> mSlots{};
+};
+
+class SamplerPattern {
+public:
+  static constexpr const char *kName = "sampler";
+
+  // Created, and so owned, by the main thread
+  explicit SamplerPattern(Device &device) {
+    for (Sampler *&sampler : mSamplers) {
+      sampler = wgpuDeviceCreateSampler(&device);
+    }
+  }
+
+  ~SamplerPattern() {
+    for (Sampler *sampler : mSamplers) {
+      wgpuSamplerRelease(sampler);
+    }
+  }
+
+  std::uint64_t step(std::minstd_rand &random) {
+    Sampler *sampler = mSamplers[random() % mSamplers.size()];
+    wgpuSamplerAddRef(sampler);
+    wgpuSamplerRelease(sampler);
+
+    return 2;
+  }
+
+private:
+  std::array<Sampler *, 4> mSamplers;
+};
+
+struct RunResult {
+  double opsPerSecond = 0;
+  ResourceHive<Texture>::LockStats lockStats;
+};
+
+template <typename Pattern>
+RunResult run(std::size_t threadCount, Clock::duration duration) {
+  // Heap allocated, a device with all its hive shards is large
+  auto device = std::make_unique<Device>();
+  std::uint64_t totalOps = 0;
+  Clock::duration elapsed{};
+
+  {
+    Pattern pattern{*device};
+    std::vector<std::uint64_t> ops(threadCount);
+    std::atomic<std::size_t> ready{0};
+    std::atomic<bool> start{false};
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+
+    for (std::size_t t = 0; t < threadCount; ++t) {
+      threads.emplace_back([&, t] {
+        std::minstd_rand random{static_cast<std::uint32_t>(t + 1)};
+        std::uint64_t count = 0;
+
+        ready.fetch_add(1);
+        while (!start.load(std::memory_order_acquire)) {
+        }
+
+        while (!stop.load(std::memory_order_relaxed)) {
+          count += pattern.step(random);
+        }
+
+        ops[t] = count;
+      });
+    }
+
+    // One frame per millisecond
+    std::thread submitter{[&] {
+      Queue *queue = &device->getQueue();
+
+      while (!start.load(std::memory_order_acquire)) {
+      }
+
+      while (!stop.load(std::memory_order_relaxed)) {
+        wgpuQueueSubmit(queue);
+        queue->onSubmissionCompleted(queue->getLastSubmissionIndex());
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      }
+    }};
+
+    while (ready.load() != threadCount) {
+    }
+
+    const auto begin = Clock::now();
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(duration);
+    stop.store(true, std::memory_order_relaxed);
+
+    for (auto &thread : threads) {
+      thread.join();
+    }
+
+    elapsed = Clock::now() - begin;
+    submitter.join();
+
+    for (std::uint64_t count : ops) {
+      totalOps += count;
+    }
+  }
+
+  // Everything is released, the last submits free the destroyed textures
+  Queue *queue = &device->getQueue();
+  wgpuQueueSubmit(queue);
+  queue->onSubmissionCompleted(queue->getLastSubmissionIndex());
+  wgpuQueueSubmit(queue);
+
+  const std::size_t leaked = device->getHive<Texture>().size();
+  if (leaked != 0) {
+    std::println("{0}: {1} textures still alive after the run", Pattern::kName,
+                 leaked);
+    std::exit(EXIT_FAILURE);
+  }
+
+  return {totalOps / std::chrono::duration<double>(elapsed).count(),
+          device->getHive<Texture>().lockStats()};
+}
+
+template <typename Pattern>
+void report(std::span<const std::size_t> threadCounts,
+            Clock::duration duration) {
+  double singleThreaded = 0;
+
+  for (std::size_t threadCount : threadCounts) {
+    const RunResult result = run<Pattern>(threadCount, duration);
+    if (threadCount == 1) {
+      singleThreaded = result.opsPerSecond;
+    }
+
+    const ResourceHive<Texture>::LockStats &locks = result.lockStats;
+    const double contendedPercent =
+        locks.acquisitions == 0
+            ? 0.0
+            : 100.0 * locks.contended / locks.acquisitions;
+    const double holdNs =
+        locks.acquisitions == 0
+            ? 0.0
+            : static_cast<double>(locks.held.count()) / locks.acquisitions;
+
+    std::println("{0:<8} threads={1:<3} {2:8.2f} Mops/s  scaling={3:5.2f}x  "
+                 "locks={4:<10} contended={5:5.2f}%  hold={6:6.1f} ns",
+                 Pattern::kName, threadCount, result.opsPerSecond / 1e6,
+                 result.opsPerSecond / singleThreaded, locks.acquisitions,
+                 contendedPercent, holdNs);
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const std::chrono::milliseconds duration{
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 200};
+
+  const std::size_t hardwareThreads =
+      std::max(1u, std::thread::hardware_concurrency());
+  const std::size_t maxThreads =
+      argc > 2 ? std::strtoul(argv[2], nullptr, 10)
+               : std::max<std::size_t>(4, 2 * hardwareThreads);
+
+  // Doubling up to maxThreads, past the hardware threads shows what
+  // oversubscription does to the locks
+  std::vector<std::size_t> threadCounts;
+  for (std::size_t threadCount = 1; threadCount <= maxThreads;
+       threadCount *= 2) {
+    threadCounts.push_back(threadCount);
+  }
+
+  std::println("hardware threads: {0}, {1} ms per run", hardwareThreads,
+               duration.count());
+
+  report<PrivatePattern>(threadCounts, duration);
+  report<SharedPattern>(threadCounts, duration);
+  report<HandoffPattern>(threadCounts, duration);
+  report<SamplerPattern>(threadCounts, duration);
+}
@@ -0,0 +1,139 @@
+#ifndef TASK_POOL_HPP_
+#define TASK_POOL_HPP_
+
+#include <algorithm>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// Worker threads running whatever driver work frame-critical threads
+/// shouldn't wait for: creating the Vulkan objects of a texture, waiting for
+/// the GPU to finish a submission and freeing what it no longer uses, see
+/// DeviceOptions::taskPool. Tasks run in the order they were posted, on
+/// whichever worker is free.
+///
+/// Coroutines move themselves over with co_await pool.schedule(), see
+/// FireAndForget.
+class TaskPool {
+public:
+  explicit TaskPool(
+      std::size_t threadCount =
+          std::max(2u, std::thread::hardware_concurrency()) - 1) {
+    mThreads.reserve(threadCount);
+    for (std::size_t i = 0; i < threadCount; ++i) {
+      mThreads.emplace_back([this] { work(); });
+    }
+  }
+
+  // Runs what is still queued first
+  ~TaskPool() {
+    {
+      std::lock_guard lock{mMutex};
+      mStop = true;
+    }
+    mWake.notify_all();
+
+    for (std::thread &thread : mThreads) {
+      thread.join();
+    }
+  }
+
+#pragma region noncopyable
+  TaskPool(const TaskPool &) = delete;
+  TaskPool &operator=(const TaskPool &) = delete;
+  TaskPool(TaskPool &&) = delete;
+  TaskPool &operator=(TaskPool &&) = delete;
+#pragma endregion noncopyable
+
+  // Tasks must not throw
+  void post(std::function<void()> task) {
+    {
+      std::lock_guard lock{mMutex};
+      mTasks.push_back(std::move(task));
+    }
+    mWake.notify_one();
+  }
+
+  void post(std::coroutine_handle<> coroutine) {
+    post([coroutine] { coroutine.resume(); });
+  }
+
+  // co_await pool.schedule() continues the coroutine on a worker
+  auto schedule() noexcept {
+    struct Awaiter {
+      TaskPool &pool;
+
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> coroutine) {
+        pool.post(coroutine);
+      }
+      void await_resume() const noexcept {}
+    };
+
+    return Awaiter{*this};
+  }
+
+  // Block until nothing is queued or running, including tasks posted by
+  // tasks. Coroutines suspended elsewhere (e.g. waiting for a submission)
+  // don't count.
+  void wait() {
+    std::unique_lock lock{mMutex};
+    mIdle.wait(lock, [this] { return mTasks.empty() && mActive == 0; });
+  }
+
+private:
+  void work() {
+    std::unique_lock lock{mMutex};
+
+    while (true) {
+      mWake.wait(lock, [this] { return mStop || !mTasks.empty(); });
+      if (mTasks.empty()) {
+        return;
+      }
+
+      std::function<void()> task = std::move(mTasks.front());
+      mTasks.pop_front();
+      ++mActive;
+
+      lock.unlock();
+      task();
+      // Whatever it captured goes before the pool counts as idle
+      task = nullptr;
+      lock.lock();
+
+      if (--mActive == 0 && mTasks.empty()) {
+        mIdle.notify_all();
+      }
+    }
+  }
+
+  std::mutex mMutex;
+  std::condition_variable mWake;
+  std::condition_variable mIdle;
+  std::deque<std::function<void()>> mTasks;
+  std::size_t mActive = 0;
+  bool mStop = false;
+  std::vector<std::thread> mThreads;
+};
+
+/// Return type of a coroutine nobody waits for: it starts right away on the
+/// calling thread, typically moves to a TaskPool with co_await
+/// pool.schedule(), and frees its frame when it finishes. It must not throw.
+struct FireAndForget {
+  struct promise_type {
+    FireAndForget get_return_object() const noexcept { return {}; }
+    std::suspend_never initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+};
+
+#endif // TASK_POOL_HPP_
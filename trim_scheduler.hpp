@@ -0,0 +1,98 @@
+#ifndef TRIM_SCHEDULER_HPP_
+#define TRIM_SCHEDULER_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/// Gives memory back in long-running sessions. After a large unload resource
+/// hives keep their now empty blocks around, which costs memory and slows
+/// down every iteration. Since elements can't move, reclaiming is limited to
+/// - freeing blocks that are entirely empty (ConcurrentHive::trimShard),
+///   which ConcurrentHive helps along by not inserting into sparse blocks
+/// - returning the BlockPool chunks no block is used from anymore
+///
+/// Each of those is a step. Every framesBetweenPasses frames a pass over all
+/// steps starts, running steps for at most budget per frame and continuing
+/// where it left off the next frame, so no frame pays for a whole pass. With
+/// retainFactor R a hive's capacity settles at no more than R times its live
+/// count plus its sparse blocks.
+///
+/// Not thread-safe, call it from the thread submitting frames.
+class TrimScheduler {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  struct Options {
+    std::uint64_t framesBetweenPasses = 300;
+    Clock::duration budget = std::chrono::microseconds{100};
+    // Capacity kept per hive shard, as a multiple of its element count
+    std::size_t retainFactor = 2;
+  };
+
+  TrimScheduler() : TrimScheduler(Options{}) {}
+  explicit TrimScheduler(const Options &options) : mOptions{options} {}
+
+#pragma region noncopyable
+  TrimScheduler(const TrimScheduler &) = delete;
+  TrimScheduler &operator=(const TrimScheduler &) = delete;
+  TrimScheduler(TrimScheduler &&) = delete;
+  TrimScheduler &operator=(TrimScheduler &&) = delete;
+#pragma endregion noncopyable
+
+  // One step per shard of a ConcurrentHive
+  template <typename Hive> void addHive(Hive &hive) {
+    for (std::size_t i = 0; i < Hive::shardCount(); ++i) {
+      addStep([&hive, i, retainFactor = mOptions.retainFactor] {
+        hive.trimShard(i, retainFactor);
+      });
+    }
+  }
+
+  // Steps run in the order they were added, so add hives before the pool
+  // their blocks are returned to
+  void addStep(std::function<void()> step) {
+    mSteps.push_back(std::move(step));
+  }
+
+  // Call once per frame
+  void onFrame() {
+    if (mCursor == 0 && ++mFramesSincePass < mOptions.framesBetweenPasses) {
+      return;
+    }
+
+    runFor(mOptions.budget);
+  }
+
+  // Run steps for about budget, e.g. when the application is idle. At least
+  // one step is run. Finishing a pass restarts the frame count.
+  void runFor(Clock::duration budget) {
+    if (mSteps.empty()) {
+      return;
+    }
+
+    const Clock::time_point deadline = Clock::now() + budget;
+
+    do {
+      mSteps[mCursor]();
+
+      if (++mCursor == mSteps.size()) {
+        mCursor = 0;
+        mFramesSincePass = 0;
+        return;
+      }
+    } while (Clock::now() < deadline);
+  }
+
+private:
+  const Options mOptions;
+  std::vector<std::function<void()>> mSteps;
+  // Next step of the current pass, 0 if no pass is in progress
+  std::size_t mCursor = 0;
+  std::uint64_t mFramesSincePass = 0;
+};
+
+#endif // TRIM_SCHEDULER_HPP_
@@ -0,0 +1,1408 @@
+#ifndef WEBGPU_RESOURCES_HPP_
+#define WEBGPU_RESOURCES_HPP_
+
+#include "biased_ref_count.hpp"
+#include "block_pool.hpp"
+#include "concurrent_hive.hpp"
+#include "deferred_destruction.hpp"
+#include "generational_handle.hpp"
+#include "gpu_memory_allocator.hpp"
+#include "intrusive_resource.hpp"
+#include "plf_hive.hpp"
+#include "recycle_cache.hpp"
+#include "resource_stats.hpp"
+#include "staging_ring.hpp"
+#include "task_pool.hpp"
+#include "trim_scheduler.hpp"
+#include "work_stealing_pool.hpp"
+#include "workload_profile.hpp"
+
+#include <boost/intrusive_ptr.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <format>
+#include <map>
+#include <mutex>
+#include <print>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// WebGPU resources stored in plf::hive, so that a resource does not have to
+/// store a pointer to the data structure but intrusive_ptr_release can still
+/// reach it. This started as a singleton for all resources and has since
+/// become one hub per device: a resource finds the storage and the device it
+/// belongs to through the header of its aligned hive block (see
+/// ConcurrentHive::contextOf), still without a back-pointer. Devices are
+/// created and destroyed independently and share nothing.
+///
+/// 03_intrusive_hive_singletonhub.cpp walks through it, the stress targets
+/// drive the same C API.
+
+// Resources print their construction and destruction, which is what the demo
+// is about but drowns anything creating millions of them. Define
+// WEBGPU_RESOURCES_TRACE to 0 to compile it out.
+#ifndef WEBGPU_RESOURCES_TRACE
+#define WEBGPU_RESOURCES_TRACE 1
+#endif
+
+template <typename... Args>
+void trace(std::format_string<Args...> format, Args &&...args) {
+  if constexpr (WEBGPU_RESOURCES_TRACE) {
+    std::println(format, std::forward<Args>(args)...);
+  }
+}
+
+// https://www.w3.org/TR/webgpu/#dom-gpubuffer-internal-state-slot
+enum class TextureInternalState {
+  Available,
+  Unavailable,
+  Destroyed,
+};
+
+// Subset of WGPUTextureFormat
+enum class TextureFormat : std::uint32_t {
+  RGBA8Unorm,
+  BGRA8Unorm,
+  RGBA16Float,
+  RGBA32Float,
+  Depth32Float,
+};
+
+// Subset of WGPUTextureDescriptor, what decides the VkImage and its memory
+struct TextureDescriptor {
+  std::uint32_t width = 1;
+  std::uint32_t height = 1;
+  std::uint32_t depthOrArrayLayers = 1;
+  std::uint32_t mipLevelCount = 1;
+  std::uint32_t sampleCount = 1;
+  TextureFormat format = TextureFormat::RGBA8Unorm;
+  // WGPUTextureUsage flags
+  std::uint32_t usage = 0;
+
+  friend bool operator==(const TextureDescriptor &,
+                         const TextureDescriptor &) = default;
+
+  // Estimated size of the GPU memory, all mip levels and samples
+  std::size_t byteSize() const noexcept {
+    std::size_t texelBytes = 4;
+    if (format == TextureFormat::RGBA16Float) {
+      texelBytes = 8;
+    } else if (format == TextureFormat::RGBA32Float) {
+      texelBytes = 16;
+    }
+
+    std::size_t size = 0;
+    for (std::uint32_t level = 0; level < mipLevelCount; ++level) {
+      size += std::size_t{std::max(width >> level, 1u)} *
+              std::max(height >> level, 1u) * depthOrArrayLayers;
+    }
+
+    return size * texelBytes * sampleCount;
+  }
+};
+
+// Stand-in for VkMemoryRequirements::alignment of the texture's VkImage
+constexpr std::uint64_t kTextureAlignment = 4096;
+
+struct TextureDescriptorHash {
+  std::size_t operator()(const TextureDescriptor &descriptor) const noexcept {
+    // FNV-1a over the fields
+    std::size_t hash = 0xcbf29ce484222325ull;
+    for (std::uint32_t field :
+         {descriptor.width, descriptor.height, descriptor.depthOrArrayLayers,
+          descriptor.mipLevelCount, descriptor.sampleCount,
+          static_cast<std::uint32_t>(descriptor.format), descriptor.usage}) {
+      hash = (hash ^ field) * 0x100000001b3ull;
+    }
+
+    return hash;
+  }
+};
+
+// Have some class that can hold Vulkan object to be destroyed. The submission
+// index it has to wait for is kept by DeferredDestructionQueue.
+struct TextureToBeDestroyed {
+  // vk::Texture vulkanTexture;
+  GpuMemoryAllocation memory;
+};
+
+// The part of a texture submit-time validation looks at. It is stored in its
+// own array per hive block, next to but separate from the Texture objects
+// (which will grow Vulkan handles, descriptors, views...), so that scanning
+// all textures streams far fewer cache lines, see
+// Resources::countDestroyedTextures.
+struct TextureHotState {
+  // Atomic as textures created with Resources::createTextureAsync become
+  // Available on a TaskPool worker
+  std::atomic<TextureInternalState> state{TextureInternalState::Available};
+  // Latest queue submission with commands using the texture, see
+  // Texture::markUsed
+  std::atomic<std::uint64_t> lastUsedSubmissionIndex{0};
+};
+
+class Texture;
+class Buffer;
+class Sampler;
+class TextureView;
+class BindGroupLayout;
+class PipelineLayout;
+class BindGroup;
+class ShaderModule;
+class RenderPipeline;
+class ComputePipeline;
+class QuerySet;
+class CommandEncoder;
+class Resources;
+
+// All resource hives use the same block size so that they can share one
+// BlockPool per device
+constexpr std::size_t kResourceBlockSize = 64 * 1024;
+static_assert(kResourceBlockSize % 4096 == 0,
+              "Resource blocks are whole pages, see BlockPool");
+
+// Allocate resource blocks on 64 KiB boundaries so that plf::hive can find the
+// block owning a resource by masking its address. This makes
+// hive::erase_pointer in intrusive_ptr_release O(1) instead of walking the
+// hive's list of blocks.
+//
+// The rest of the block layout follows at compile time: every block has the
+// same capacity, whatever fits, and the skipfield is 16-bit once more than
+// 255 resources fit (all of them but Texture are 8 to 48 bytes, an 8-bit
+// skipfield would leave most of their block unused). With
+// PowerOfTwoSlots the slot of a resource is also found with a shift.
+template <bool PowerOfTwoSlots = false> struct ResourceBlockTraits {
+  static constexpr std::size_t block_alignment = kResourceBlockSize;
+  static constexpr bool power_of_two_element_slots = PowerOfTwoSlots;
+};
+
+namespace plf {
+template <> struct hive_block_traits<Texture> : ResourceBlockTraits<> {
+  using slot_metadata_type = TextureHotState;
+};
+
+template <> struct hive_block_traits<Buffer> : ResourceBlockTraits<> {};
+
+// Released and referenced from every thread: 64-byte slots never straddle a
+// cache line, unlike 48-byte ones
+template <> struct hive_block_traits<Sampler> : ResourceBlockTraits<true> {};
+
+template <> struct hive_block_traits<TextureView> : ResourceBlockTraits<> {};
+template <>
+struct hive_block_traits<BindGroupLayout> : ResourceBlockTraits<> {};
+template <> struct hive_block_traits<PipelineLayout> : ResourceBlockTraits<> {};
+template <> struct hive_block_traits<BindGroup> : ResourceBlockTraits<> {};
+template <> struct hive_block_traits<ShaderModule> : ResourceBlockTraits<> {};
+template <> struct hive_block_traits<RenderPipeline> : ResourceBlockTraits<> {};
+template <>
+struct hive_block_traits<ComputePipeline> : ResourceBlockTraits<> {};
+template <> struct hive_block_traits<QuerySet> : ResourceBlockTraits<> {};
+template <> struct hive_block_traits<CommandEncoder> : ResourceBlockTraits<> {};
+} // namespace plf
+
+// Every resource hive of a device takes its blocks from the device's
+// BlockPool and has the device as its context, see Resources
+template <typename T>
+using ResourceHive = ConcurrentHive<T, 32, BlockPoolAllocator<T>, Resources>;
+
+// Reference counting comes from IntrusiveResource just as with
+// boost::intrusive_ref_counter, except that intrusive_ptr_release hands the
+// texture back to its device's Resources instead of deleting it.
+//
+// Resource classes are final and not polymorphic: a hive only ever holds
+// exact Texture objects, so a virtual destructor would just add a vptr to
+// every element and make hive erasure an indirect call. A backend provides
+// its own concrete classes (e.g. a VulkanTexture) as the hive element types
+// instead of deriving from these. The C API is typed per object, so it needs
+// no dynamic type either.
+class Texture final : public IntrusiveResource<Texture, Resources> {
+public:
+  // Names the type in DeviceOptions::blockLimits and WorkloadProfile
+  static constexpr std::string_view kTypeName = "texture";
+
+  // Sub-allocates the texture's memory from its device, see
+  // GpuMemoryAllocator
+  explicit Texture(const TextureDescriptor &descriptor = {});
+
+  // Leaves the GPU objects to initialize(), see Resources::createTextureAsync
+  struct DeferredInitialization {};
+  Texture(const TextureDescriptor &descriptor,
+          DeferredInitialization) noexcept;
+
+  // Follow: https://www.w3.org/TR/webgpu/#buffer-destruction
+  // Notice: no class destructor is called, this doesn't release CPU side
+  // object!
+  void destroy();
+
+  ~Texture();
+
+  // Record that commands for the given submission use this texture. Called
+  // for every draw/dispatch binding it, so in the common case of a texture
+  // already marked for this submission it is a single load.
+  void markUsed(std::uint64_t submissionIndex) noexcept {
+    std::atomic<std::uint64_t> &lastUsed = hotState().lastUsedSubmissionIndex;
+    std::uint64_t current = lastUsed.load(std::memory_order_relaxed);
+
+    // Encoders on other threads may mark it concurrently, keep the maximum
+    while (current < submissionIndex &&
+           !lastUsed.compare_exchange_weak(current, submissionIndex,
+                                           std::memory_order_relaxed)) {
+    }
+  }
+
+  // Set if the texture was created in handle mode, see
+  // Resources::createTextureHandle
+  Handle<Texture> handle() const noexcept { return mHandle; }
+
+  const TextureDescriptor &descriptor() const noexcept { return mDescriptor; }
+
+  // False while a texture from Resources::createTextureAsync is still being
+  // created, and once it is destroyed
+  bool isAvailable() const noexcept {
+    return hotState().state.load(std::memory_order_acquire) ==
+           TextureInternalState::Available;
+  }
+
+  // Found through the texture's hive block, there is no back-pointer
+  Resources &getDevice() const noexcept {
+    return *ResourceHive<Texture>::contextOf(this);
+  }
+
+private:
+  friend class Resources;
+
+  TextureHotState &hotState() const noexcept {
+    return ResourceHive<Texture>::hive_type::slot_metadata(this);
+  }
+
+  // Create the GPU objects of a DeferredInitialization texture, which is
+  // Unavailable until then
+  void initialize();
+
+  TextureDescriptor mDescriptor;
+  // vk::Image bound to it
+  GpuMemoryAllocation mMemory;
+  Handle<Texture> mHandle;
+  // When destroy() was called, if stats were enabled then
+  std::chrono::steady_clock::time_point mDestroyedAt;
+};
+
+// Command encoders never leave the thread recording them, so there is no point
+// paying for atomic AddRef/Release. Debug builds assert that this holds.
+class CommandEncoder final
+    : public IntrusiveResource<CommandEncoder, Resources,
+                               ThreadUnsafeRefCount> {
+public:
+  static constexpr std::string_view kTypeName = "commandEncoder";
+
+  CommandEncoder() noexcept { trace("CommandEncoder::Constructor"); }
+
+  ~CommandEncoder() {
+    trace("CommandEncoder::Destructor with count {0}", useCount());
+  }
+};
+
+// Samplers (the default ones especially) get AddRef/Release from every thread
+// all the time. With a biased counter only the creating thread touches the
+// object's cache line without atomics, see biased_ref_count.hpp.
+class Sampler final
+    : public IntrusiveResource<Sampler, Resources, BiasedRefCount> {
+public:
+  static constexpr std::string_view kTypeName = "sampler";
+
+  Sampler() noexcept { trace("Sampler::Constructor"); }
+
+  ~Sampler() { trace("Sampler::Destructor"); }
+};
+
+// The other WebGPU object types. Storage and reference counting are the same
+// for all of them, they only differ in the Vulkan objects they will wrap.
+class Buffer final : public IntrusiveResource<Buffer, Resources> {
+public:
+  static constexpr std::string_view kTypeName = "buffer";
+};
+
+// Keeps its texture alive. Released from the TextureView hive while one of its
+// shards is locked, which then locks a Texture hive shard, see ConcurrentHive.
+class TextureView final : public IntrusiveResource<TextureView, Resources> {
+public:
+  static constexpr std::string_view kTypeName = "textureView";
+
+  explicit TextureView(boost::intrusive_ptr<Texture> texture) noexcept
+      : mTexture{std::move(texture)} {}
+
+  Texture *getTexture() const noexcept { return mTexture.get(); }
+
+private:
+  boost::intrusive_ptr<Texture> mTexture;
+};
+
+class BindGroupLayout final
+    : public IntrusiveResource<BindGroupLayout, Resources> {
+public:
+  static constexpr std::string_view kTypeName = "bindGroupLayout";
+};
+
+class PipelineLayout final
+    : public IntrusiveResource<PipelineLayout, Resources> {
+public:
+  static constexpr std::string_view kTypeName = "pipelineLayout";
+};
+
+class BindGroup final : public IntrusiveResource<BindGroup, Resources> {
+public:
+  static constexpr std::string_view kTypeName = "bindGroup";
+};
+
+class ShaderModule final : public IntrusiveResource<ShaderModule, Resources> {
+public:
+  static constexpr std::string_view kTypeName = "shaderModule";
+};
+
+class RenderPipeline final
+    : public IntrusiveResource<RenderPipeline, Resources> {
+public:
+  static constexpr std::string_view kTypeName = "renderPipeline";
+};
+
+class ComputePipeline final
+    : public IntrusiveResource<ComputePipeline, Resources> {
+public:
+  static constexpr std::string_view kTypeName = "computePipeline";
+};
+
+class QuerySet final : public IntrusiveResource<QuerySet, Resources> {
+public:
+  static constexpr std::string_view kTypeName = "querySet";
+};
+
+#pragma region Queue
+// Stand-in for the Vulkan queue and its timeline semaphore.
+class Queue {
+public:
+  // With a taskPool, submit() leaves waiting for the GPU and freeing what it
+  // is done with to the pool
+  Queue(Resources &device, TaskPool *taskPool) noexcept
+      : mDevice{device}, mTaskPool{taskPool} {}
+
+  // Coroutines still waiting for a submission never run
+  ~Queue() {
+    for (const Waiter &waiter : mWaiters) {
+      waiter.coroutine.destroy();
+    }
+  }
+
+#pragma region noncopyable
+  Queue(const Queue &) = delete;
+  Queue &operator=(const Queue &) = delete;
+  Queue(Queue &&) = delete;
+  Queue &operator=(Queue &&) = delete;
+#pragma endregion noncopyable
+
+  Resources &getDevice() const noexcept { return mDevice; }
+
+  // Index of the latest submission. Commands using a resource that were
+  // already submitted belong to a submission <= this one.
+  std::uint64_t getLastSubmissionIndex() const noexcept {
+    return mLastSubmissionIndex.load(std::memory_order_acquire);
+  }
+
+  // Index of the submission commands recorded now will be part of
+  std::uint64_t getPendingSubmissionIndex() const noexcept {
+    return getLastSubmissionIndex() + 1;
+  }
+
+  // Latest submission the GPU has finished
+  std::uint64_t getCompletedSubmissionIndex() const noexcept {
+    return mCompletedSubmissionIndex.load(std::memory_order_acquire);
+  }
+
+  // Called when the GPU timeline reaches submissionIndex, e.g. from a fence
+  // callback or after reading the timeline semaphore value. Coroutines
+  // waiting for it continue on their TaskPool.
+  void onSubmissionCompleted(std::uint64_t submissionIndex) {
+    mCompletedSubmissionIndex.store(submissionIndex,
+                                    std::memory_order_release);
+
+    std::lock_guard lock{mWaitersMutex};
+    std::erase_if(mWaiters, [submissionIndex](const Waiter &waiter) {
+      if (waiter.submissionIndex > submissionIndex) {
+        return false;
+      }
+
+      waiter.pool->post(waiter.coroutine);
+      return true;
+    });
+  }
+
+  // co_await queue.completion(index, pool) continues the coroutine on pool
+  // once the GPU finished submission index, or right away if it already has
+  auto completion(std::uint64_t submissionIndex, TaskPool &pool) noexcept {
+    struct Awaiter {
+      Queue &queue;
+      std::uint64_t submissionIndex;
+      TaskPool &pool;
+
+      bool await_ready() const noexcept {
+        return queue.getCompletedSubmissionIndex() >= submissionIndex;
+      }
+
+      // Checked again under the lock onSubmissionCompleted takes after
+      // storing the index, so no completion is missed
+      bool await_suspend(std::coroutine_handle<> coroutine) {
+        std::lock_guard lock{queue.mWaitersMutex};
+        if (await_ready()) {
+          return false;
+        }
+
+        queue.mWaiters.push_back({submissionIndex, coroutine, &pool});
+        return true;
+      }
+
+      void await_resume() const noexcept {}
+    };
+
+    return Awaiter{*this, submissionIndex, pool};
+  }
+
+  // The GPU object is freed once lastUsedSubmissionIndex has completed
+  void enqueueDestruction(std::uint64_t lastUsedSubmissionIndex,
+                          TextureToBeDestroyed texture) {
+    mTexturesToBeDestroyed.push(lastUsedSubmissionIndex, std::move(texture));
+  }
+
+  void submit();
+
+private:
+  struct Waiter {
+    std::uint64_t submissionIndex;
+    std::coroutine_handle<> coroutine;
+    TaskPool *pool;
+  };
+
+  // Free the GPU objects of every texture the GPU is done with in one batch
+  void collectDestroyed();
+
+  FireAndForget collectDestroyedWhenCompleted(std::uint64_t submissionIndex);
+
+  Resources &mDevice;
+  TaskPool *const mTaskPool;
+  std::atomic<std::uint64_t> mLastSubmissionIndex{0};
+  std::atomic<std::uint64_t> mCompletedSubmissionIndex{0};
+  DeferredDestructionQueue<TextureToBeDestroyed> mTexturesToBeDestroyed;
+  // collect() is single consumer, held by whichever pool worker collects
+  std::mutex mCollectMutex;
+  std::mutex mWaitersMutex;
+  std::vector<Waiter> mWaiters;
+};
+#pragma endregion Queue
+
+#pragma region Per-device Resource Hub
+// Set at device creation. Everything is optional, by default the hives start
+// empty with plf::hive's own block limits.
+struct DeviceOptions {
+  // Block capacity limits per resource type, keyed by T::kTypeName. Both are
+  // clamped to what fits into a kResourceBlockSize block (e.g. 618 textures),
+  // see block_capacity_hard_limits. Every block takes kResourceBlockSize
+  // whatever its capacity, so limits below that count leave the rest of the
+  // block unused: always with a lower max, and with a lower min for the first
+  // blocks, as capacities grow from min to max with the hive.
+  std::map<std::string, plf::hive_limits, std::less<>> blockLimits;
+
+  // Peak counts of a previous run, see Resources::recordWorkloadProfile.
+  // Every hive reserves that much up front, so that the first frames create
+  // resources without allocating.
+  WorkloadProfile profile;
+
+  // When and how much memory is given back after resources are released
+  TrimScheduler::Options trim;
+
+  // Count creations, releases and destroy-to-release latencies, see
+  // Resources::snapshotStats. Can be changed later with setStatsEnabled.
+  // Ignored when WEBGPU_RESOURCE_STATS is 0, by default in NDEBUG builds.
+  bool collectStats = true;
+
+  // GPU memory released textures may keep alive for reuse by a texture of
+  // the same descriptor, see Resources::createTexture. 0 disables recycling.
+  std::size_t textureRecycleBudget = 0;
+
+  // How texture memory is allocated from the driver
+  GpuMemoryAllocator::Options gpuMemory;
+
+  // Persistently mapped memory all texture and buffer uploads of the device
+  // are staged in, see StagingRing. Allocated on the first upload.
+  std::uint64_t stagingRingSize = 32 * 1024 * 1024;
+
+  // Runs texture creation for createTextureAsync and the freeing of
+  // destroyed textures' GPU objects, off the threads calling the API. Not
+  // owned, may be shared by devices and must outlive them. Without one both
+  // happen on the calling thread.
+  TaskPool *taskPool = nullptr;
+};
+
+// One ResourceHive per resource type, all taking their blocks from the same
+// BlockPool. hive<T>() is resolved at compile time, so the generic release
+// path finds the storage of a resource without a map lookup or virtual call.
+//
+// Resources are listed before the resources referencing them (TextureView
+// after Texture...). The hives are cleared last to first, so releasing a
+// resource only ever touches hives that are still alive.
+template <typename... Resource> class ResourceHives {
+  static_assert((!std::is_polymorphic_v<Resource> && ...),
+                "Resources are stored by their exact type, a vtable only "
+                "makes them larger and their destruction indirect");
+
+public:
+  ResourceHives(Resources &device, BlockPool &blockPool,
+                const DeviceOptions &options)
+      : mSlots{Init<Resource>{device, blockPool, options}...} {}
+
+#pragma region noncopyable
+  ResourceHives(const ResourceHives &) = delete;
+  ResourceHives &operator=(const ResourceHives &) = delete;
+  ResourceHives(ResourceHives &&) = delete;
+  ResourceHives &operator=(ResourceHives &&) = delete;
+#pragma endregion noncopyable
+
+  ~ResourceHives() {
+    [this]<std::size_t... Index>(std::index_sequence<Index...>) {
+      (std::get<sizeof...(Resource) - 1 - Index>(mSlots).hive.clear(), ...);
+    }(std::index_sequence_for<Resource...>{});
+  }
+
+  template <typename T> ResourceHive<T> &hive() noexcept {
+    return std::get<Slot<T>>(mSlots).hive;
+  }
+  template <typename T> const ResourceHive<T> &hive() const noexcept {
+    return std::get<Slot<T>>(mSlots).hive;
+  }
+
+  template <typename T> ResourceCounters &counters() noexcept {
+    return std::get<Slot<T>>(mSlots).counters;
+  }
+  template <typename T> const ResourceCounters &counters() const noexcept {
+    return std::get<Slot<T>>(mSlots).counters;
+  }
+
+  // f(ResourceHive<T> &) for every resource type, in order
+  template <typename F> void forEach(F &&f) {
+    std::apply([&f](Slot<Resource> &...slot) { (f(slot.hive), ...); },
+               mSlots);
+  }
+  template <typename F> void forEach(F &&f) const {
+    std::apply([&f](const Slot<Resource> &...slot) { (f(slot.hive), ...); },
+               mSlots);
+  }
+
+private:
+  template <typename T> struct Init {
+    Resources &device;
+    BlockPool &blockPool;
+    const DeviceOptions &options;
+  };
+
+  // std::tuple can only construct its elements from one argument each
+  template <typename T> struct Slot {
+    explicit Slot(const Init<T> &init)
+        : hive{blockLimits(init.options), BlockPoolAllocator<T>{init.blockPool},
+               &init.device} {}
+
+    static plf::hive_limits blockLimits(const DeviceOptions &options) {
+      const auto it = options.blockLimits.find(T::kTypeName);
+      if (it == options.blockLimits.end()) {
+        return ResourceHive<T>::hive_type::block_capacity_default_limits();
+      }
+
+      // plf::hive throws for limits outside of its hard ones
+      constexpr plf::hive_limits hard =
+          ResourceHive<T>::hive_type::block_capacity_hard_limits();
+      const std::size_t max = std::clamp(it->second.max, hard.min, hard.max);
+
+      return {std::clamp(it->second.min, hard.min, max), max};
+    }
+
+    ResourceHive<T> hive;
+    ResourceCounters counters;
+  };
+
+  std::tuple<Slot<Resource>...> mSlots;
+};
+
+using TextureRecycleCache =
+    RecycleCache<TextureDescriptor, Texture, TextureDescriptorHash>;
+
+// Exported by Resources::snapshotStats, e.g. pushed to a metrics pipeline
+// once a second
+struct ResourceStatsSnapshot {
+  std::chrono::steady_clock::time_point time;
+  // Every resource type, in the order of Resources::mHives
+  std::vector<ResourceTypeStats> types;
+  // Textures destroy()ed whose CPU object is still referenced
+  std::size_t destroyedTextures = 0;
+  // Time from destroy() to the release of the last reference, of all textures
+  // freed so far
+  LatencyHistogram textureDestroyToRelease;
+  // Released textures kept for reuse, see DeviceOptions::textureRecycleBudget.
+  // Cached ones still count as live in types.
+  TextureRecycleCache::Stats textureRecycling;
+  // Texture memory, including that of destroyed textures the GPU may still
+  // use
+  GpuMemoryAllocator::Stats gpuMemory;
+  StagingRing::Stats staging;
+};
+
+// Everything a device owns. Not copyable or movable: its address is the
+// context of its resource hives.
+class Resources {
+public:
+  Resources() : Resources(DeviceOptions{}) {}
+
+  explicit Resources(const DeviceOptions &options)
+      : mQueue{*this, options.taskPool}, mTaskPool{options.taskPool},
+        mStatsEnabled{options.collectStats},
+        mTextureRecycleCache{options.textureRecycleBudget},
+        mGpuMemory{options.gpuMemory}, mStagingRing{options.stagingRingSize},
+        mHives{*this, mBlockPool, options},
+        mTrimScheduler{options.trim} {
+    mHives.forEach([&]<typename T>(ResourceHive<T> &hive) {
+      // Blocks are taken from mBlockPool, which faults them in right away
+      hive.reserve(options.profile.shardPeaks(T::kTypeName));
+      mTrimScheduler.addHive(hive);
+    });
+
+    // Blocks the hives free go back to mBlockPool, so trim it last
+    mTrimScheduler.addStep([this] { mBlockPool.releaseFreeChunks(); });
+    mTrimScheduler.addStep([this] { mGpuMemory.releaseFreeMemory(); });
+  }
+
+  // Tasks for this device still on the TaskPool use it
+  ~Resources() {
+    if (mTaskPool != nullptr) {
+      mTaskPool->wait();
+    }
+  }
+
+  // Any resource type, e.g. create<Buffer>()
+  template <typename T, typename... Args>
+  boost::intrusive_ptr<T> create(Args &&...args) {
+    boost::intrusive_ptr<T> resource{
+        getHive<T>().emplace(std::forward<Args>(args)...)};
+    recordCreated<T>(1);
+
+    return resource;
+  }
+
+  boost::intrusive_ptr<Texture> createTexture() { return create<Texture>(); }
+
+  // Hands out a released texture of the same descriptor when recycling is
+  // enabled (DeviceOptions::textureRecycleBudget) and the GPU is done with
+  // it, saving both the hive slot and the GPU allocation. Its contents are
+  // whatever the previous user left, like a new texture's the implementation
+  // clears them lazily on first use.
+  boost::intrusive_ptr<Texture>
+  createTexture(const TextureDescriptor &descriptor) {
+    if (mTextureRecycleCache.enabled()) {
+      if (Texture *texture = mTextureRecycleCache.take(
+              descriptor, mQueue.getCompletedSubmissionIndex())) {
+        return boost::intrusive_ptr<Texture>{texture};
+      }
+    }
+
+    return create<Texture>(descriptor);
+  }
+
+  // Returns right away with a texture that is Unavailable until its GPU
+  // objects have been created on DeviceOptions::taskPool, so the calling
+  // thread never waits for the driver. It can be referenced, put into bind
+  // groups and destroyed meanwhile, see Texture::isAvailable.
+  boost::intrusive_ptr<Texture>
+  createTextureAsync(const TextureDescriptor &descriptor) {
+    assert(mTaskPool != nullptr);
+
+    boost::intrusive_ptr<Texture> texture =
+        create<Texture>(descriptor, Texture::DeferredInitialization{});
+    texture->hotState().state.store(TextureInternalState::Unavailable,
+                                    std::memory_order_relaxed);
+    initializeTexture(texture, *mTaskPool);
+
+    return texture;
+  }
+
+  // Staging memory for size bytes of texture data, which the caller writes
+  // directly before the next submit copies it to texture. Empty if the
+  // staging ring is full, see StagingRing::allocate.
+  StagingSlice mapTextureUpload(Texture &texture, std::uint64_t size) {
+    const std::uint64_t submissionIndex = mQueue.getPendingSubmissionIndex();
+    const StagingSlice slice = mStagingRing.allocate(size, submissionIndex);
+
+    if (slice) {
+      // vkCmdCopyBufferToImage(staging buffer, slice.offset, image) on the
+      // command buffer of the pending submission
+      texture.markUsed(submissionIndex);
+    }
+
+    return slice;
+  }
+
+  // Same for size bytes of buffer data, written to the buffer at bufferOffset
+  // by vkCmdCopyBuffer(staging buffer, slice.offset, buffer) on the command
+  // buffer of the pending submission. Buffers don't own a GPU object yet, so
+  // unlike textures there is no last use to record.
+  StagingSlice mapBufferUpload(const Buffer &, std::uint64_t /*bufferOffset*/,
+                               std::uint64_t size) {
+    return mStagingRing.allocate(size, mQueue.getPendingSubmissionIndex());
+  }
+
+  // Textures the application still references, not destroyed ones or those
+  // kept for recycling, e.g. to save them to a HubSnapshot. Must not run
+  // concurrently with the release of a texture of this device.
+  std::vector<boost::intrusive_ptr<Texture>> liveTextures() {
+    std::vector<boost::intrusive_ptr<Texture>> textures;
+    getHive<Texture>().forEach([&textures](Texture &texture) {
+      if (texture.useCount() != 0 &&
+          texture.hotState().state != TextureInternalState::Destroyed) {
+        textures.emplace_back(&texture);
+      }
+    });
+
+    return textures;
+  }
+
+  // Create a texture for every descriptor, e.g. those of a HubSnapshot, in
+  // parallel on pool. Each thread fills a hive shard of its own, reserve
+  // them beforehand with DeviceOptions::profile. The textures are returned
+  // in the order of descriptors.
+  std::vector<boost::intrusive_ptr<Texture>>
+  restoreTextures(std::span<const TextureDescriptor> descriptors,
+                  WorkStealingPool &pool) {
+    // Big enough that a thread keeps its shard lock and allocator warm,
+    // small enough to spread over the threads
+    static constexpr std::size_t kBatchSize = 256;
+
+    std::vector<boost::intrusive_ptr<Texture>> textures(descriptors.size());
+    pool.parallelFor(
+        (descriptors.size() + kBatchSize - 1) / kBatchSize,
+        [&](std::size_t batch) {
+          const std::size_t end =
+              std::min(descriptors.size(), (batch + 1) * kBatchSize);
+          for (std::size_t i = batch * kBatchSize; i < end; ++i) {
+            textures[i] = createTexture(descriptors[i]);
+          }
+        });
+
+    return textures;
+  }
+
+  // Create n textures at once, e.g. when streaming in a level. They are
+  // constructed next to each other in one block (or as few as possible if n
+  // doesn't fit into one) under a single lock, so iterating them later walks
+  // memory linearly.
+  void createTextures(std::size_t n, boost::intrusive_ptr<Texture> *out) {
+    // Whatever out held is released here rather than under the shard lock
+    std::fill_n(out, n, nullptr);
+    getHive<Texture>().emplaceContiguous(n, out);
+    recordCreated<Texture>(n);
+  }
+
+  // The same for the C API. The textures start without any reference.
+  void createTextures(std::size_t n, Texture **out) {
+    getHive<Texture>().emplaceContiguous(n, out);
+    recordCreated<Texture>(n);
+  }
+
+  // Handle mode: the texture is also registered in a HandleTable, so the C
+  // API can hand out a Handle<Texture> instead of a raw pointer into the hive.
+  // The handle is invalidated when the texture is erased.
+  Handle<Texture> createTextureHandle() {
+    Texture *texture = getHive<Texture>().emplace();
+    texture->mHandle = mTextureHandles.insert(texture);
+    recordCreated<Texture>(1);
+
+    return texture->mHandle;
+  }
+
+  // nullptr if the texture the handle referred to is gone
+  Texture *resolve(Handle<Texture> handle) const noexcept {
+    return mTextureHandles.resolve(handle);
+  }
+
+  // Only reads the hot state of each texture, not the Texture objects
+  std::size_t countDestroyedTextures() {
+    std::size_t count = 0;
+    getHive<Texture>().forEachSlotMetadata(
+        [&count](const TextureHotState &hot) {
+          count += (hot.state == TextureInternalState::Destroyed);
+        });
+
+    return count;
+  }
+
+  // The GPU object of every texture went away with the lost VkDevice, so
+  // there is nothing to enqueue for destruction: all textures only become
+  // destroyed, split over the threads of pool. The CPU objects stay until
+  // their last reference is released, ~Texture then returns their ranges of
+  // the GpuMemoryAllocator right away, no submission can use them anymore.
+  // Must not run concurrently with destroy() of a texture of this device.
+  void loseDevice(WorkStealingPool &pool) {
+    getHive<Texture>().parallelForEachSlotMetadata(
+        pool, [](TextureHotState &hot) {
+          hot.state = TextureInternalState::Destroyed;
+        });
+
+    // Nothing left worth reusing
+    dropRecycledTextures();
+  }
+
+  // Free every texture kept for reuse, e.g. when memory runs low
+  void dropRecycledTextures() {
+    mTextureRecycleCache.clear(&Resources::eraseRecycled);
+  }
+
+  template <typename T> ResourceHive<T> &getHive() {
+    return mHives.template hive<T>();
+  }
+  HandleTable<Texture> &getTextureHandles() { return mTextureHandles; }
+
+  // Called by IntrusiveResource once the last reference is released. The
+  // resource's hive block leads to the shard it lives in, whichever device
+  // that belongs to, so releases of different devices never share anything.
+  template <typename T> static void erase(const T *resource) {
+    if constexpr (std::is_same_v<T, Texture>) {
+      if (recycle(resource)) {
+        return;
+      }
+    }
+
+    recordReleased(std::span<const T *const>{&resource, 1});
+    ResourceHive<T>::erase(resource);
+  }
+
+  // Called by intrusive_ptr_release_many with every resource it released the
+  // last reference to
+  template <typename T> static void erase(std::span<T *> resources) {
+    if constexpr (std::is_same_v<T, Texture>) {
+      const auto kept = std::remove_if(
+          resources.begin(), resources.end(),
+          [](const Texture *texture) { return recycle(texture); });
+      resources = resources.first(
+          static_cast<std::size_t>(kept - resources.begin()));
+    }
+
+    recordReleased(std::span<const T *const>{resources});
+    ResourceHive<T>::eraseMany(resources);
+  }
+
+  Queue &getQueue() { return mQueue; }
+  GpuMemoryAllocator &getGpuMemory() { return mGpuMemory; }
+  StagingRing &getStagingRing() { return mStagingRing; }
+  TrimScheduler &getTrimScheduler() { return mTrimScheduler; }
+
+  // Peak counts so far, to be saved and passed to the next run's
+  // DeviceOptions
+  WorkloadProfile recordWorkloadProfile() const {
+    WorkloadProfile profile;
+    mHives.forEach([&profile]<typename T>(const ResourceHive<T> &hive) {
+      profile.setShardPeaks(T::kTypeName, hive.peakShardSizes());
+    });
+
+    return profile;
+  }
+
+  // Stats enabled with DeviceOptions::collectStats can be switched at any
+  // time, e.g. only while a profiling overlay is shown. Compiled out when
+  // WEBGPU_RESOURCE_STATS is 0.
+  void setStatsEnabled(bool enabled) noexcept {
+    mStatsEnabled.store(enabled, std::memory_order_relaxed);
+  }
+
+  bool statsEnabled() const noexcept {
+    if constexpr (WEBGPU_RESOURCE_STATS) {
+      return mStatsEnabled.load(std::memory_order_relaxed);
+    } else {
+      return false;
+    }
+  }
+
+  // Counters of every resource type, with rates since the previous call, and
+  // the occupancy of its hive blocks. Locks every hive shard once, meant to
+  // be called periodically by whatever exports the metrics.
+  ResourceStatsSnapshot snapshotStats() {
+    ResourceStatsSnapshot snapshot;
+    snapshot.time = std::chrono::steady_clock::now();
+
+    mHives.forEach([&]<typename T>(const ResourceHive<T> &hive) {
+      const ResourceCounters::Totals totals =
+          mHives.template counters<T>().totals();
+
+      ResourceTypeStats &stats = snapshot.types.emplace_back();
+      stats.type = T::kTypeName;
+      stats.created = totals.created;
+      stats.released = totals.released;
+      stats.collectFrom(hive);
+    });
+
+    snapshot.destroyedTextures = countDestroyedTextures();
+    snapshot.textureDestroyToRelease = mTextureDestroyToRelease.histogram();
+    snapshot.textureRecycling = mTextureRecycleCache.stats();
+    snapshot.gpuMemory = mGpuMemory.stats();
+    snapshot.staging = mStagingRing.stats();
+
+    std::lock_guard lock{mStatsMutex};
+    const double seconds =
+        std::chrono::duration<double>(snapshot.time - mPreviousStats.time)
+            .count();
+
+    if (!mPreviousStats.types.empty() && seconds > 0) {
+      for (std::size_t i = 0; i < snapshot.types.size(); ++i) {
+        ResourceTypeStats &stats = snapshot.types[i];
+        const ResourceTypeStats &previous = mPreviousStats.types[i];
+        stats.createdPerSecond = (stats.created - previous.created) / seconds;
+        stats.releasedPerSecond =
+            (stats.released - previous.released) / seconds;
+      }
+    }
+
+    mPreviousStats = snapshot;
+    return snapshot;
+  }
+
+private:
+  friend class Texture;
+
+  template <typename T> void recordCreated(std::size_t count) noexcept {
+    if (statsEnabled()) {
+      mHives.template counters<T>().onCreated(count);
+    }
+  }
+
+  // The resources may belong to different devices
+  template <typename T>
+  static void recordReleased(std::span<const T *const> resources) noexcept {
+    if constexpr (WEBGPU_RESOURCE_STATS) {
+      for (const T *resource : resources) {
+        Resources &device = *ResourceHive<T>::contextOf(resource);
+        if (device.statsEnabled()) {
+          device.mHives.template counters<T>().onReleased();
+        }
+      }
+    }
+  }
+
+  void recordDestroyToRelease(std::chrono::nanoseconds latency) noexcept {
+    if (statsEnabled()) {
+      mTextureDestroyToRelease.record(latency);
+    }
+  }
+
+  // Keep a texture whose last reference is gone in its device's recycle cache
+  // instead of erasing it. Destroyed textures have no GPU memory left to
+  // reuse, and handle mode ones have handed out a handle that must become
+  // invalid.
+  static bool recycle(const Texture *texture) {
+    Resources &device = *ResourceHive<Texture>::contextOf(texture);
+    if (!device.mTextureRecycleCache.enabled() || texture->handle() ||
+        texture->hotState().state == TextureInternalState::Destroyed) {
+      return false;
+    }
+
+    // Hive elements are never const, only the pointers handed to erase
+    Texture *recycled = const_cast<Texture *>(texture);
+    const TextureDescriptor &descriptor = recycled->descriptor();
+    device.mTextureRecycleCache.insert(
+        descriptor, recycled,
+        recycled->hotState().lastUsedSubmissionIndex.load(
+            std::memory_order_relaxed),
+        descriptor.byteSize(), &Resources::eraseRecycled);
+
+    return true;
+  }
+
+  // Keeps the texture alive until it is initialized
+  static FireAndForget initializeTexture(boost::intrusive_ptr<Texture> texture,
+                                         TaskPool &pool) {
+    co_await pool.schedule();
+    texture->initialize();
+  }
+
+  // Evicted from the recycle cache, now really released
+  static void eraseRecycled(Texture *texture) {
+    recordReleased(std::span<const Texture *const>{&texture, 1});
+    ResourceHive<Texture>::erase(texture);
+  }
+
+  // Declared first so that it outlives textures enqueueing their destruction
+  // while mHives is destroyed
+  Queue mQueue;
+  TaskPool *const mTaskPool;
+  // Same for the handles textures remove
+  HandleTable<Texture> mTextureHandles;
+  // And the stats they record
+  std::atomic<bool> mStatsEnabled;
+  LatencyCounters mTextureDestroyToRelease;
+  // Only points into mHives, which destroys what is still cached
+  TextureRecycleCache mTextureRecycleCache;
+  // Textures allocate from it when created, so it outlives mHives. Memory
+  // still queued for destruction goes away with it.
+  GpuMemoryAllocator mGpuMemory;
+  StagingRing mStagingRing;
+  // Blocks of all resource hives come from here instead of the general heap,
+  // growing and shrinking the hives is an O(1) free-list operation
+  BlockPool mBlockPool{kResourceBlockSize};
+  // plf::hive has several nice properties for storage
+  // - stable pointers this is a trick that can help us
+  //  1. make maps std::map<resource, state> memory safe!
+  //  2. implementation of intrusive_ptr_release super easy
+  // - compact storage
+  // plf::hive itself is not thread-safe, so resources are kept in
+  // ConcurrentHives: simultaneous creation and erasure from any thread, each
+  // locking only one of its shards.
+  ResourceHives<Texture, Buffer, Sampler, TextureView, BindGroupLayout,
+                PipelineLayout, BindGroup, ShaderModule, RenderPipeline,
+                ComputePipeline, QuerySet, CommandEncoder>
+      mHives;
+  TrimScheduler mTrimScheduler;
+  // Previous snapshotStats, for the rates
+  std::mutex mStatsMutex;
+  ResourceStatsSnapshot mPreviousStats;
+
+#pragma region noncopyable
+public:
+  Resources(const Resources &) = delete;
+  Resources &operator=(const Resources &) = delete;
+  Resources(Resources &&) = delete;
+  Resources &operator=(Resources &&) = delete;
+#pragma endregion noncopyable
+};
+#pragma endregion Per-device Resource Hub
+
+inline void Queue::submit() {
+  // vkQueueSubmit(..., signal timeline semaphore with the new index)
+  const std::uint64_t submissionIndex =
+      mLastSubmissionIndex.fetch_add(1, std::memory_order_release) + 1;
+
+  // Finish releases other threads queued for biased resources this thread
+  // created
+  BiasedRefCount::mergeQueued();
+
+  if (mTaskPool != nullptr) {
+    collectDestroyedWhenCompleted(submissionIndex);
+  } else {
+    collectDestroyed();
+  }
+}
+
+inline void Queue::collectDestroyed() {
+  std::lock_guard lock{mCollectMutex};
+
+  const std::uint64_t completedSubmissionIndex =
+      mCompletedSubmissionIndex.load(std::memory_order_acquire);
+
+  // Uploads of finished submissions are done with their staging memory
+  mDevice.getStagingRing().retire(completedSubmissionIndex);
+
+  mTexturesToBeDestroyed.collect(
+      completedSubmissionIndex,
+      [this](std::span<TextureToBeDestroyed> textures) {
+        // Batched: destroy all images and hand their memory back to the
+        // allocator at once instead of a driver call per texture.
+        trace("Queue::submit destroying {0} textures", textures.size());
+        mDevice.getGpuMemory().freeMany(
+            textures | std::views::transform(&TextureToBeDestroyed::memory));
+      });
+}
+
+// Everything destroyed before this submission whose last use was at most
+// this submission is retired once it completes
+inline FireAndForget
+Queue::collectDestroyedWhenCompleted(std::uint64_t submissionIndex) {
+  co_await completion(submissionIndex, *mTaskPool);
+  collectDestroyed();
+}
+
+inline Texture::Texture(const TextureDescriptor &descriptor,
+                        DeferredInitialization) noexcept
+    : mDescriptor{descriptor} {
+  trace("Texture::Constructor");
+}
+
+inline void Texture::initialize() {
+  mMemory = getDevice().getGpuMemory().allocate(mDescriptor.byteSize(),
+                                                kTextureAlignment);
+
+  // vkCreateImage, vkBindImageMemory, then the layout transition and initial
+  // upload go to the transfer queue, which the first submission using the
+  // texture waits for
+
+  TextureInternalState expected = TextureInternalState::Unavailable;
+  if (!hotState().state.compare_exchange_strong(
+          expected, TextureInternalState::Available,
+          std::memory_order_acq_rel)) {
+    // destroy() or device loss came first and left the memory to this
+    getDevice().getQueue().enqueueDestruction(
+        hotState().lastUsedSubmissionIndex.load(std::memory_order_relaxed),
+        TextureToBeDestroyed{std::exchange(mMemory, {})});
+  }
+}
+
+inline Texture::Texture(const TextureDescriptor &descriptor)
+    : mDescriptor{descriptor},
+      mMemory{getDevice().getGpuMemory().allocate(descriptor.byteSize(),
+                                                  kTextureAlignment)} {
+  trace("Texture::Constructor");
+}
+
+inline void Texture::destroy() {
+  // Set state to destroyed
+  const TextureInternalState previous = hotState().state.exchange(
+      TextureInternalState::Destroyed, std::memory_order_acq_rel);
+  if (previous == TextureInternalState::Destroyed) {
+    // Valid according to the specification. Nothing to do.
+    return;
+  }
+
+  // Unmap
+  // ...
+
+  // Only an explicit destroy() leaves the CPU object around, ~Texture calls
+  // it once the last reference is already gone
+  if (useCount() != 0 && getDevice().statsEnabled()) {
+    mDestroyedAt = std::chrono::steady_clock::now();
+  }
+
+  // Staging memory of uploads (and of mappable buffers) is a slice of the
+  // device's StagingRing, reused once its submission completes, nothing to
+  // delete here
+
+  if (previous == TextureInternalState::Unavailable) {
+    // Still being created on the TaskPool, initialize() frees what it
+    // allocated once it sees the texture destroyed
+    return;
+  }
+
+  // Enqueue GPU Memory destruction. This can run on any thread, also from
+  // ~Texture while a ConcurrentHive shard is locked, hence the lock-free
+  // queue. GPU memory is freed in a batch by the first submit after the GPU
+  // has finished the last submission using the texture (by a TaskPool
+  // worker once that submit completes, if the device has one). Using a
+  // destroyed texture is a validation error, so that can't change anymore.
+  getDevice().getQueue().enqueueDestruction(
+      hotState().lastUsedSubmissionIndex.load(std::memory_order_relaxed),
+      TextureToBeDestroyed{std::exchange(mMemory, {})});
+}
+
+inline Texture::~Texture() {
+  // Enqueue GPU memory destruction if explicit destroy() call was not made
+  if (hotState().state != TextureInternalState::Destroyed) {
+    destroy();
+  } else if (mDestroyedAt != std::chrono::steady_clock::time_point{}) {
+    getDevice().recordDestroyToRelease(std::chrono::steady_clock::now() -
+                                       mDestroyedAt);
+  }
+
+  // Still set if loseDevice() marked the texture destroyed instead
+  if (mMemory) {
+    getDevice().getGpuMemory().free(std::exchange(mMemory, {}));
+  }
+
+  if (mHandle) {
+    getDevice().getTextureHandles().remove(mHandle);
+  }
+
+  // Continue with destruction of actual CPU object of the implementation
+  trace("Texture::Destructor with count {0}", useCount());
+}
+
+// This part shows how raw native WebGPU functions can be now implemented using
+// above functionality.
+#pragma region WebGPU
+// Stands in for WGPUDevice, every object is created from one
+using Device = Resources;
+
+// With a descriptor the texture may be a recycled one, see
+// Resources::createTexture(const TextureDescriptor &)
+inline Texture *
+wgpuInstanceRequestTexture(Device *device,
+                           const TextureDescriptor *descriptor = nullptr) {
+  boost::intrusive_ptr<Texture> texture{descriptor
+                                            ? device->createTexture(*descriptor)
+                                            : device->createTexture()};
+
+  // Because WebGPU functions do NOT return intrusive_ptr (that will be
+  // destroyed at the end of this function) but raw pointer we artificially
+  // increase reference. It will be 2 and 1 after end of this function
+  intrusive_ptr_add_ref(texture.get());
+
+  return texture.get();
+}
+
+// Bulk version of wgpuInstanceRequestTexture, every texture starts with one
+// reference owned by the caller.
+inline void wgpuDeviceCreateTextures(Device *device, std::size_t count,
+                                     Texture **textures) {
+  device->createTextures(count, textures);
+
+  for (std::size_t i = 0; i < count; ++i) {
+    intrusive_ptr_add_ref(textures[i]);
+  }
+}
+
+inline void wgpuTextureDestroy(Texture *texture) { texture->destroy(); }
+inline void wgpuTextureAddRef(Texture *texture) {
+  intrusive_ptr_add_ref(texture);
+}
+inline void wgpuTextureRelease(Texture *texture) {
+  intrusive_ptr_release(texture);
+}
+
+// Release many textures at once, e.g. when a scene unloads. Textures whose last
+// reference is gone are erased together, each hive block once. Reuses the
+// array, its contents are unspecified afterwards.
+inline void wgpuTextureReleaseMany(Texture **textures, std::size_t count) {
+  intrusive_ptr_release_many(std::span<Texture *>{textures, count});
+}
+
+// Handle mode of the texture functions. Every call validates the handle in
+// O(1), a stale handle is a validation error instead of a use-after-free.
+using TextureHandle = Handle<Texture>;
+
+// Handles are only unique within their device
+inline TextureHandle wgpuDeviceCreateTextureHandle(Device *device) {
+  const TextureHandle handle = device->createTextureHandle();
+  intrusive_ptr_add_ref(device->resolve(handle));
+
+  return handle;
+}
+
+inline Texture *resolveTextureHandle(Device *device, TextureHandle handle) {
+  Texture *texture = device->resolve(handle);
+  if (texture == nullptr) {
+    std::println("Validation error: invalid texture handle {0:#x}",
+                 handle.value);
+  }
+
+  return texture;
+}
+
+inline void wgpuTextureHandleDestroy(Device *device, TextureHandle handle) {
+  if (Texture *texture = resolveTextureHandle(device, handle)) {
+    texture->destroy();
+  }
+}
+inline void wgpuTextureHandleAddRef(Device *device, TextureHandle handle) {
+  if (Texture *texture = resolveTextureHandle(device, handle)) {
+    intrusive_ptr_add_ref(texture);
+  }
+}
+inline void wgpuTextureHandleRelease(Device *device, TextureHandle handle) {
+  if (Texture *texture = resolveTextureHandle(device, handle)) {
+    intrusive_ptr_release(texture);
+  }
+}
+
+inline CommandEncoder *wgpuDeviceCreateCommandEncoder(Device *device) {
+  boost::intrusive_ptr<CommandEncoder> commandEncoder{
+      device->create<CommandEncoder>()};
+  intrusive_ptr_add_ref(commandEncoder.get());
+
+  return commandEncoder.get();
+}
+
+inline void wgpuCommandEncoderAddRef(CommandEncoder *commandEncoder) {
+  intrusive_ptr_add_ref(commandEncoder);
+}
+inline void wgpuCommandEncoderRelease(CommandEncoder *commandEncoder) {
+  intrusive_ptr_release(commandEncoder);
+}
+
+inline Sampler *wgpuDeviceCreateSampler(Device *device) {
+  boost::intrusive_ptr<Sampler> sampler{device->create<Sampler>()};
+  intrusive_ptr_add_ref(sampler.get());
+
+  return sampler.get();
+}
+
+inline void wgpuSamplerAddRef(Sampler *sampler) {
+  intrusive_ptr_add_ref(sampler);
+}
+inline void wgpuSamplerRelease(Sampler *sampler) {
+  intrusive_ptr_release(sampler);
+}
+
+// Every other type follows the same pattern through Resources::create<T>
+inline Buffer *wgpuDeviceCreateBuffer(Device *device) {
+  boost::intrusive_ptr<Buffer> buffer{device->create<Buffer>()};
+  intrusive_ptr_add_ref(buffer.get());
+
+  return buffer.get();
+}
+
+inline void wgpuBufferAddRef(Buffer *buffer) { intrusive_ptr_add_ref(buffer); }
+inline void wgpuBufferRelease(Buffer *buffer) { intrusive_ptr_release(buffer); }
+
+inline TextureView *wgpuTextureCreateView(Texture *texture) {
+  boost::intrusive_ptr<TextureView> textureView{
+      texture->getDevice().create<TextureView>(
+          boost::intrusive_ptr<Texture>{texture})};
+  intrusive_ptr_add_ref(textureView.get());
+
+  return textureView.get();
+}
+
+inline void wgpuTextureViewAddRef(TextureView *textureView) {
+  intrusive_ptr_add_ref(textureView);
+}
+inline void wgpuTextureViewRelease(TextureView *textureView) {
+  intrusive_ptr_release(textureView);
+}
+
+// One copy into the staging ring, which the caller's data has to be copied
+// out of anyway, no staging buffer of its own
+inline void wgpuQueueWriteTexture(Queue *queue, Texture *texture,
+                                  const void *data, std::size_t size) {
+  const StagingSlice slice =
+      queue->getDevice().mapTextureUpload(*texture, size);
+  if (!slice) {
+    std::println("Out of memory: {0} bytes don't fit into the staging ring",
+                 size);
+    return;
+  }
+
+  std::memcpy(slice.data, data, size);
+}
+
+// Shares the staging ring with the texture uploads
+inline void wgpuQueueWriteBuffer(Queue *queue, Buffer *buffer,
+                                 std::uint64_t bufferOffset, const void *data,
+                                 std::size_t size) {
+  const StagingSlice slice =
+      queue->getDevice().mapBufferUpload(*buffer, bufferOffset, size);
+  if (!slice) {
+    std::println("Out of memory: {0} bytes don't fit into the staging ring",
+                 size);
+    return;
+  }
+
+  std::memcpy(slice.data, data, size);
+}
+
+inline void wgpuQueueSubmit(Queue *queue) {
+  queue->submit();
+  // A submit per frame, spend a little of it on giving memory back
+  queue->getDevice().getTrimScheduler().onFrame();
+}
+#pragma endregion WebGPU
+
+#endif // WEBGPU_RESOURCES_HPP_
@@ -0,0 +1,213 @@
+#ifndef WORK_STEALING_POOL_HPP_
+#define WORK_STEALING_POOL_HPP_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Worker threads for data-parallel loops like visiting every resource of a
+/// hive (see ConcurrentHive::parallelForEach), where the cost per item varies
+/// (hive blocks are anything from empty to full).
+///
+/// parallelFor splits the index range into one contiguous part per thread,
+/// the calling thread included. A thread takes indices from the front of its
+/// own part and, once that is used up, steals the back half of the largest
+/// remaining part of another thread. So most of the time every thread works
+/// on items next to each other without touching shared state, and nobody
+/// idles while work is left.
+///
+/// One parallelFor runs at a time, calls from several threads are
+/// serialized.
+class WorkStealingPool {
+public:
+  // threadCount worker threads besides the ones calling parallelFor
+  explicit WorkStealingPool(
+      std::size_t threadCount =
+          std::max(1u, std::thread::hardware_concurrency()) - 1)
+      : mParts(threadCount + 1) {
+    mThreads.reserve(threadCount);
+    for (std::size_t i = 0; i < threadCount; ++i) {
+      mThreads.emplace_back([this, i] { work(i + 1); });
+    }
+  }
+
+  ~WorkStealingPool() {
+    {
+      std::lock_guard lock{mMutex};
+      mStop = true;
+    }
+    mWake.notify_all();
+
+    for (std::thread &thread : mThreads) {
+      thread.join();
+    }
+  }
+
+#pragma region noncopyable
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+  WorkStealingPool(WorkStealingPool &&) = delete;
+  WorkStealingPool &operator=(WorkStealingPool &&) = delete;
+#pragma endregion noncopyable
+
+  // Worker threads plus the calling one
+  std::size_t concurrency() const noexcept { return mParts.size(); }
+
+  // Call task(i) for every i in [0, count) and return when all are done.
+  // Tasks run concurrently on the workers and the calling thread, must not
+  // throw and must not call parallelFor themselves.
+  template <typename Task> void parallelFor(std::size_t count, Task &&task) {
+    if (count == 0) {
+      return;
+    }
+
+    if (mThreads.empty() || count == 1) {
+      for (std::size_t i = 0; i < count; ++i) {
+        task(i);
+      }
+      return;
+    }
+
+    std::lock_guard serialize{mRunMutex};
+
+    // Workers are idle, nobody else touches the parts right now
+    const std::size_t partCount = mParts.size();
+    for (std::size_t i = 0; i < partCount; ++i) {
+      mParts[i].begin = count * i / partCount;
+      mParts[i].end = count * (i + 1) / partCount;
+    }
+
+    {
+      std::lock_guard lock{mMutex};
+      mTask = &task;
+      mInvoke = [](void *task, std::size_t index) {
+        (*static_cast<Task *>(task))(index);
+      };
+      mRunning = mThreads.size();
+      ++mGeneration;
+    }
+    mWake.notify_all();
+
+    run(0);
+
+    // The task lives on this stack frame, wait until no worker uses it
+    std::unique_lock lock{mMutex};
+    mDone.wait(lock, [this] { return mRunning == 0; });
+  }
+
+private:
+  // Indices [begin, end) left for one thread
+  struct alignas(64) Part {
+    std::mutex mutex;
+    std::size_t begin = 0;
+    std::size_t end = 0;
+  };
+
+  void work(std::size_t part) {
+    std::uint64_t generation = 0;
+
+    while (true) {
+      {
+        std::unique_lock lock{mMutex};
+        mWake.wait(lock,
+                   [&] { return mStop || mGeneration != generation; });
+        if (mStop) {
+          return;
+        }
+        generation = mGeneration;
+      }
+
+      run(part);
+
+      std::lock_guard lock{mMutex};
+      if (--mRunning == 0) {
+        mDone.notify_one();
+      }
+    }
+  }
+
+  // Run indices of part, then stolen ones, until no part has any left
+  void run(std::size_t part) {
+    do {
+      std::size_t index;
+      while (pop(part, index)) {
+        mInvoke(mTask, index);
+      }
+    } while (steal(part));
+  }
+
+  bool pop(std::size_t part, std::size_t &index) {
+    Part &own = mParts[part];
+    std::lock_guard lock{own.mutex};
+
+    if (own.begin == own.end) {
+      return false;
+    }
+
+    index = own.begin++;
+    return true;
+  }
+
+  // Move the back half of the largest other part into part, which is empty.
+  // The parts only shrink during a run, so once all are empty it is over.
+  bool steal(std::size_t part) {
+    static constexpr std::size_t kNone = SIZE_MAX;
+    std::size_t victim = kNone;
+    std::size_t largest = 0;
+
+    for (std::size_t i = 0; i < mParts.size(); ++i) {
+      // May change right after, checked again below
+      std::lock_guard lock{mParts[i].mutex};
+      const std::size_t size = mParts[i].end - mParts[i].begin;
+      if (i != part && size > largest) {
+        victim = i;
+        largest = size;
+      }
+    }
+
+    if (victim == kNone) {
+      return false;
+    }
+
+    std::size_t begin;
+    std::size_t end;
+    {
+      Part &from = mParts[victim];
+      std::lock_guard lock{from.mutex};
+      if (from.begin == from.end) {
+        // Taken meanwhile, look again
+        return true;
+      }
+
+      end = from.end;
+      begin = from.begin + (from.end - from.begin) / 2;
+      from.end = begin;
+    }
+
+    Part &own = mParts[part];
+    std::lock_guard lock{own.mutex};
+    own.begin = begin;
+    own.end = end;
+
+    return true;
+  }
+
+  std::vector<Part> mParts;
+  std::vector<std::thread> mThreads;
+
+  std::mutex mRunMutex;
+  std::mutex mMutex;
+  std::condition_variable mWake;
+  std::condition_variable mDone;
+  bool mStop = false;
+  std::uint64_t mGeneration = 0;
+  std::size_t mRunning = 0;
+  void *mTask = nullptr;
+  void (*mInvoke)(void *, std::size_t) = nullptr;
+};
+
+#endif // WORK_STEALING_POOL_HPP_
@@ -0,0 +1,80 @@
+#ifndef WORKLOAD_PROFILE_HPP_
+#define WORKLOAD_PROFILE_HPP_
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// Peak element count of every shard of every resource hive, dumped at the
+/// end of a run (see ConcurrentHive::peakShardSizes) and fed back at device
+/// creation the next time, which reserves that much up front so the first
+/// frames don't allocate.
+///
+/// Stored as text, one line per resource type:
+///   <type> <peak of shard 0> <peak of shard 1> ...
+class WorkloadProfile {
+public:
+  void setShardPeaks(std::string_view type, std::vector<std::size_t> peaks) {
+    mShardPeaks.insert_or_assign(std::string{type}, std::move(peaks));
+  }
+
+  // Empty if the type wasn't recorded
+  std::span<const std::size_t> shardPeaks(std::string_view type) const {
+    const auto it = mShardPeaks.find(type);
+    if (it == mShardPeaks.end()) {
+      return {};
+    }
+
+    return it->second;
+  }
+
+  void save(std::ostream &out) const {
+    for (const auto &[type, peaks] : mShardPeaks) {
+      out << type;
+      for (std::size_t peak : peaks) {
+        out << ' ' << peak;
+      }
+      out << '\n';
+    }
+  }
+
+  // Lines that don't parse are skipped, a broken profile only costs the
+  // reservation.
+  static WorkloadProfile load(std::istream &in) {
+    WorkloadProfile profile;
+    std::string line;
+
+    while (std::getline(in, line)) {
+      std::istringstream fields{line};
+      std::string type;
+      if (!(fields >> type)) {
+        continue;
+      }
+
+      std::vector<std::size_t> peaks;
+      std::size_t peak;
+      while (fields >> peak) {
+        peaks.push_back(peak);
+      }
+
+      if (fields.eof()) {
+        profile.setShardPeaks(type, std::move(peaks));
+      }
+    }
+
+    return profile;
+  }
+
+private:
+  std::map<std::string, std::vector<std::size_t>, std::less<>> mShardPeaks;
+};
+
+#endif // WORKLOAD_PROFILE_HPP_